@@ -0,0 +1,177 @@
+// Compares the keyword classifier used by 'tokens::symbolType()' against
+// the length switch + 'memcmp' classifier it replaced.
+//
+//   c++ -O2 -std=c++11 -I inst/include benchmark/benchmark-keywords.cpp -o benchmark-keywords
+//   ./benchmark-keywords
+//
+// Symbols are drawn from a vocabulary weighted roughly by how often each
+// appears in CRAN package sources: mostly short identifiers and common
+// function names, with keywords making up about a fifth of all symbols.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sourcetools/tokenization/tokenization.h>
+
+namespace {
+
+using namespace sourcetools::tokens;
+using sourcetools::index_type;
+
+inline TokenType legacySymbolType(const char* string, index_type n)
+{
+  if (n < 2 || n > 13) {
+    return SYMBOL;
+  } else if (n == 2) {
+    if (!std::memcmp(string, "in", n)) return KEYWORD_IN;
+    if (!std::memcmp(string, "if", n)) return KEYWORD_IF;
+    if (!std::memcmp(string, "NA", n)) return KEYWORD_NA;
+  } else if (n == 3) {
+    if (!std::memcmp(string, "for", n)) return KEYWORD_FOR;
+    if (!std::memcmp(string, "Inf", n)) return KEYWORD_Inf;
+    if (!std::memcmp(string, "NaN", n)) return KEYWORD_NaN;
+  } else if (n == 4) {
+    if (!std::memcmp(string, "else", n)) return KEYWORD_ELSE;
+    if (!std::memcmp(string, "next", n)) return KEYWORD_NEXT;
+    if (!std::memcmp(string, "TRUE", n)) return KEYWORD_TRUE;
+    if (!std::memcmp(string, "NULL", n)) return KEYWORD_NULL;
+  } else if (n == 5) {
+    if (!std::memcmp(string, "while", n)) return KEYWORD_WHILE;
+    if (!std::memcmp(string, "break", n)) return KEYWORD_BREAK;
+    if (!std::memcmp(string, "FALSE", n)) return KEYWORD_FALSE;
+  } else if (n == 6) {
+    if (!std::memcmp(string, "repeat", n)) return KEYWORD_REPEAT;
+  } else if (n == 8) {
+    if (!std::memcmp(string, "function", n)) return KEYWORD_FUNCTION;
+    if (!std::memcmp(string, "NA_real_", n)) return KEYWORD_NA_real_;
+  } else if (n == 11) {
+    if (!std::memcmp(string, "NA_integer_", n)) return KEYWORD_NA_integer_;
+    if (!std::memcmp(string, "NA_complex_", n)) return KEYWORD_NA_complex_;
+  } else if (n == 13) {
+    if (!std::memcmp(string, "NA_character_", n)) return KEYWORD_NA_character_;
+  }
+
+  return SYMBOL;
+}
+
+struct Weighted
+{
+  const char* symbol;
+  int weight;
+};
+
+const Weighted VOCABULARY[] = {
+  { "x", 60 }, { "i", 30 }, { "n", 20 }, { "y", 20 }, { "data", 15 },
+  { "object", 12 }, { "value", 12 }, { "name", 10 }, { "result", 8 },
+  { "df", 8 }, { "j", 8 }, { "f", 6 }, { "args", 6 }, { "env", 6 },
+  { "c", 40 }, { "list", 15 }, { "length", 12 }, { "paste0", 10 },
+  { "is.null", 10 }, { "stop", 10 }, { "return", 15 }, { "names", 10 },
+  { "vapply", 4 }, { "lapply", 8 }, { "character", 6 }, { "seq_along", 6 },
+  { "inherits", 4 }, { "identical", 4 }, { "missing", 4 }, { "nchar", 3 },
+  { "structure", 3 }, { "match.arg", 3 }, { "invisible", 4 }, { "sprintf", 4 },
+  { "function", 20 }, { "if", 20 }, { "else", 8 }, { "NULL", 12 },
+  { "TRUE", 12 }, { "FALSE", 10 }, { "for", 4 }, { "in", 4 }, { "NA", 4 },
+  { "while", 1 }, { "next", 1 }, { "break", 1 }, { "repeat", 1 },
+  { "Inf", 1 }, { "NaN", 1 }, { "NA_character_", 1 }, { "NA_integer_", 1 },
+  { "NA_real_", 1 }
+};
+
+// Symbols are stored back to back in one buffer, as they would be in a
+// document, and kept small enough to stay in cache.
+struct Symbols
+{
+  std::string text;
+  std::vector<index_type> offsets;
+  std::vector<index_type> sizes;
+};
+
+Symbols generate(std::size_t count)
+{
+  std::vector<const char*> pool;
+  for (std::size_t i = 0; i < sizeof(VOCABULARY) / sizeof(VOCABULARY[0]); ++i)
+    for (int j = 0; j < VOCABULARY[i].weight; ++j)
+      pool.push_back(VOCABULARY[i].symbol);
+
+  std::srand(42);
+  Symbols symbols;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const char* symbol = pool[std::rand() % pool.size()];
+    symbols.offsets.push_back(symbols.text.size());
+    symbols.sizes.push_back(std::strlen(symbol));
+    symbols.text += symbol;
+    symbols.text += ' ';
+  }
+
+  return symbols;
+}
+
+struct Legacy
+{
+  TokenType operator()(const char* string, index_type n) const
+  {
+    return legacySymbolType(string, n);
+  }
+};
+
+struct Current
+{
+  Current() : table(detail::keywordTable()) {}
+
+  TokenType operator()(const char* string, index_type n) const
+  {
+    return table.lookup(string, n);
+  }
+
+  const detail::KeywordTable& table;
+};
+
+// Classifiers are passed as function objects, so that they're inlined
+// into the timing loop just as the keyword table's 'lookup()' is inlined
+// into the tokenizer.
+template <typename Classifier>
+double nanoseconds(const Symbols& symbols, Classifier classify, TokenType* pChecksum)
+{
+  const char* text = symbols.text.data();
+  std::size_t n = symbols.offsets.size();
+
+  double best = 1E9;
+  for (int i = 0; i < 10; ++i)
+  {
+    TokenType checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < 100; ++pass)
+      for (std::size_t j = 0; j < n; ++j)
+        checksum += classify(text + symbols.offsets[j], symbols.sizes[j]);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+    *pChecksum = checksum;
+  }
+  return best * 1E9 / (100.0 * n);
+}
+
+} // anonymous namespace
+
+int main()
+{
+  Symbols symbols = generate(1 << 14);
+
+  TokenType legacy, current;
+  double before = nanoseconds(symbols, Legacy(), &legacy);
+  double after = nanoseconds(symbols, Current(), &current);
+
+  std::printf("length switch + memcmp: %.2f ns/symbol\n", before);
+  std::printf("perfect hash:           %.2f ns/symbol (%.2fx)\n", after, before / after);
+
+  if (legacy != current)
+  {
+    std::printf("classifiers disagree!\n");
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+// Measures how parallel parsing scales with the number of threads: both
+// as 'parseParallel()' chooses them (no more than there are cores, and
+// only as many as the document is big enough for), and forced, through
+// 'ParallelParser' itself.
+//
+//   c++ -O2 -std=c++11 -pthread -I inst/include benchmark/benchmark-parallel-parser.cpp -o benchmark-parallel-parser
+//   ./benchmark-parallel-parser [file]
+//
+// Without a file, a ~50 MB document of generated model code and dput()
+// output is used.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sourcetools/parse/parse.h>
+
+namespace {
+
+std::string generate()
+{
+  std::string code;
+  code.reserve(50 << 20);
+
+  std::srand(42);
+  char buffer[128];
+  for (int n = 0; code.size() < (50 << 20); ++n)
+  {
+    std::snprintf(buffer, sizeof(buffer),
+                  "fit%d <- function(data, weights = NULL)\n{\n", n);
+    code += buffer;
+    for (int i = 0; i < 8; ++i)
+    {
+      std::snprintf(buffer, sizeof(buffer),
+                    "  b%d <- %d.%d * data$x%d +\n    %d.%d * data[[\"y%d\"]]\n",
+                    i, std::rand() % 100, std::rand() % 1000, i,
+                    std::rand() % 100, std::rand() % 1000, i);
+      code += buffer;
+    }
+    code += "  if (is.null(weights)) b0 else\n    b0 * weights\n}\n";
+
+    code += "data <- structure(list(x = c(";
+    for (int i = 0; i < 32; ++i)
+    {
+      std::snprintf(buffer, sizeof(buffer), "%d.%d, ", std::rand() % 1000, std::rand() % 100);
+      code += buffer;
+    }
+    code += "NA), label = \"some\\nlabel\"), class = \"data.frame\")\n";
+  }
+
+  return code;
+}
+
+std::string read(const char* path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    std::fprintf(stderr, "failed to read '%s'\n", path);
+    std::exit(1);
+  }
+
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+enum Mode { SEQUENTIAL, AUTOMATIC, FORCED };
+
+double seconds(const std::string& code, Mode mode, sourcetools::index_type threads)
+{
+  double best = 1E9;
+  for (int i = 0; i < 3; ++i)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+      sourcetools::parser::ParseStatus status;
+      if (mode == SEQUENTIAL)
+        sourcetools::parser::Parser(code).parse(&status);
+      else if (mode == AUTOMATIC)
+        sourcetools::parseParallel(code.data(), code.size(), &status, threads);
+      else
+        sourcetools::parser::ParallelParser(code.data(), code.size(), threads).parse(&status);
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  std::string code = argc > 1 ? read(argv[1]) : generate();
+  std::printf("%.1f MB\n", code.size() / 1E6);
+
+  std::printf("%u cores\n", std::thread::hardware_concurrency());
+
+  double sequential = seconds(code, SEQUENTIAL, 1);
+  std::printf("sequential: %8.1f ms\n", sequential * 1E3);
+
+  using sourcetools::parser::ParallelParser;
+  for (int threads = 1; threads <= 16; threads *= 2)
+  {
+    double automatic = seconds(code, AUTOMATIC, threads);
+    double forced = seconds(code, FORCED, threads);
+    std::printf("%2d threads: %8.1f ms (%.2fx, using %d); forced: %8.1f ms (%.2fx)\n",
+                threads,
+                automatic * 1E3, sequential / automatic,
+                static_cast<int>(ParallelParser::usefulThreads(code.size(), threads)),
+                forced * 1E3, sequential / forced);
+  }
+
+  return 0;
+}
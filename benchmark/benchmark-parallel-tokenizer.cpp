@@ -0,0 +1,88 @@
+// Measures how parallel tokenization scales with the number of threads.
+//
+//   c++ -O2 -std=c++11 -pthread -I inst/include benchmark/benchmark-parallel-tokenizer.cpp -o benchmark-parallel-tokenizer
+//   ./benchmark-parallel-tokenizer [file]
+//
+// Without a file, a ~100 MB dput()-style document is generated.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sourcetools/tokenization/tokenization.h>
+
+namespace {
+
+std::string generate()
+{
+  std::string code;
+  code.reserve(100 << 20);
+
+  std::srand(42);
+  char buffer[64];
+  while (code.size() < (100 << 20))
+  {
+    code += "structure(list(x = c(";
+    for (int i = 0; i < 64; ++i)
+    {
+      std::snprintf(buffer, sizeof(buffer), "%d.%d, ", std::rand() % 1000, std::rand() % 100);
+      code += buffer;
+    }
+    code += "NA), label = \"some\\nlabel\", f = `my var`[[1]]), class = \"data.frame\")\n";
+  }
+
+  return code;
+}
+
+std::string read(const char* path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    std::fprintf(stderr, "failed to read '%s'\n", path);
+    std::exit(1);
+  }
+
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+double seconds(const std::string& code, sourcetools::index_type threads)
+{
+  double best = 1E9;
+  for (int i = 0; i < 5; ++i)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<sourcetools::tokens::Token> tokens = threads == 0 ?
+      sourcetools::tokenize(code) :
+      sourcetools::tokenizeParallel(code.data(), code.size(), threads);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  std::string code = argc > 1 ? read(argv[1]) : generate();
+  std::printf("%.1f MB\n", code.size() / 1E6);
+
+  double sequential = seconds(code, 0);
+  std::printf("sequential: %8.1f ms\n", sequential * 1E3);
+
+  for (int threads = 1; threads <= 16; threads *= 2)
+  {
+    double parallel = seconds(code, threads);
+    std::printf("%2d threads: %8.1f ms (%.2fx)\n",
+                threads, parallel * 1E3, sequential / parallel);
+  }
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+// Measures the memory traffic of building parse trees: how many heap
+// allocations a parse makes, and how long it takes to build and then free
+// the tree, for a large generated file (or the files given).
+//
+//   c++ -O2 -std=c++11 -I inst/include benchmark/benchmark-parser-arena.cpp -o benchmark-parser-arena
+//   ./benchmark-parser-arena [file.R ...]
+//
+// Heap allocations are counted by replacing the global 'operator new';
+// blocks taken by the parse tree's arena are counted separately.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include <sourcetools/parse/Parser.h>
+
+namespace {
+
+std::size_t s_allocations = 0;
+
+} // anonymous namespace
+
+void* operator new(std::size_t n)
+{
+  ++s_allocations;
+  if (void* p = std::malloc(n))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+namespace {
+
+using namespace sourcetools;
+
+std::string generate()
+{
+  std::string code;
+  char buffer[256];
+
+  for (int i = 0; i < 20000; ++i)
+  {
+    std::snprintf(buffer, sizeof(buffer),
+                  "f%d <- function(x, y = %d, ...) {\n"
+                  "  if (is.null(x)) stop(\"missing 'x'\")\n"
+                  "  z <- lapply(seq_along(x), function(i) x[[i]] * y + %d)\n"
+                  "  list(a = z, b = c(1, 2, 3), c = paste0(\"f\", %d))\n"
+                  "}\n",
+                  i, i, i, i);
+    code += buffer;
+  }
+
+  return code;
+}
+
+std::string read(const char* path)
+{
+  std::ifstream file(path);
+  std::stringstream ss;
+  ss << file.rdbuf();
+  return ss.str();
+}
+
+index_type countNodes(const parser::ParseNode* pNode)
+{
+  index_type count = 1;
+  const parser::ParseNode::Children& children = pNode->children();
+  for (index_type i = 0; i < utils::size(children); ++i)
+    count += countNodes(children[i]);
+  return count;
+}
+
+double milliseconds(std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end)
+{
+  return std::chrono::duration<double>(end - start).count() * 1E3;
+}
+
+void run(const std::string& code)
+{
+  double parse = 1E9, teardown = 1E9;
+  std::size_t allocations = 0, blocks = 0, bytes = 0;
+  index_type nodes = 0;
+
+  for (int i = 0; i < 10; ++i)
+  {
+    typedef std::chrono::steady_clock Clock;
+
+    parser::Parser parser(code);
+    parser::ParseStatus* pStatus = new parser::ParseStatus;
+
+    std::size_t before = s_allocations;
+    Clock::time_point start = Clock::now();
+    parser::ParseNode* pRoot = parser.parse(pStatus);
+    Clock::time_point parsed = Clock::now();
+    allocations = s_allocations - before;
+
+    nodes = countNodes(pRoot);
+    blocks = pStatus->arena()->blocks();
+    bytes = pStatus->arena()->bytes();
+
+    Clock::time_point freeing = Clock::now();
+    delete pStatus;
+    Clock::time_point freed = Clock::now();
+
+    parse = std::min(parse, milliseconds(start, parsed));
+    teardown = std::min(teardown, milliseconds(freeing, freed));
+  }
+
+  std::printf("%.1f MB, %d nodes\n", code.size() / 1E6, nodes);
+  std::printf("  heap allocations: %8lu (%.2f per node)\n",
+              static_cast<unsigned long>(allocations),
+              static_cast<double>(allocations) / nodes);
+  std::printf("  arena blocks:     %8lu (%.1f MB)\n",
+              static_cast<unsigned long>(blocks), bytes / 1E6);
+  std::printf("  parse:            %8.2f ms\n", parse);
+  std::printf("  free:             %8.2f ms\n", teardown);
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+    run(generate());
+
+  for (int i = 1; i < argc; ++i)
+    run(read(argv[i]));
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+// Checks that parse time grows linearly with nesting depth, for the
+// shapes of code that produce the deepest trees: nested calls (as in
+// nested 'list()' literals), nested braces, and long pipelines.
+//
+//   c++ -O2 -std=c++11 -I inst/include benchmark/benchmark-parser-depth.cpp -o benchmark-parser-depth
+//   ./benchmark-parser-depth
+//
+// Prints the time per level of nesting for depths from 10 to 10,000, and
+// exits with a failure status if it grows by more than 4x between depths
+// of 100 and 10,000.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include <sourcetools/parse/Parser.h>
+
+namespace {
+
+using namespace sourcetools;
+
+std::string repeat(const std::string& text, int times)
+{
+  std::string result;
+  result.reserve(text.size() * times);
+  for (int i = 0; i < times; ++i)
+    result += text;
+  return result;
+}
+
+std::string nestedCalls(int depth)
+{
+  return repeat("list(a = 1, b = ", depth) + "NULL" + repeat(")", depth);
+}
+
+std::string nestedBraces(int depth)
+{
+  return repeat("{\n x <- 1\n", depth) + repeat("}\n", depth);
+}
+
+std::string pipeline(int depth)
+{
+  return "x" + repeat(" %>%\n  f(y = 1)", depth);
+}
+
+double nanosecondsPerLevel(const std::string& code, int depth)
+{
+  // Repeat shallow parses enough times to be measurable.
+  int repetitions = std::max(1, 10000 / depth);
+
+  double best = 1E9;
+  for (int i = 0; i < 5; ++i)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int j = 0; j < repetitions; ++j)
+    {
+      parser::Parser parser(code);
+      parser::ParseStatus status;
+      parser.parse(&status);
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+
+  return best * 1E9 / (static_cast<double>(repetitions) * depth);
+}
+
+bool run(const char* name, std::string (*generate)(int))
+{
+  std::printf("%s\n", name);
+
+  double shallow = 0, deep = 0;
+  for (int depth = 10; depth <= 10000; depth *= 10)
+  {
+    double time = nanosecondsPerLevel(generate(depth), depth);
+    std::printf("  depth %5d: %8.1f ns/level\n", depth, time);
+
+    if (depth == 100)
+      shallow = time;
+    else if (depth == 10000)
+      deep = time;
+  }
+
+  return deep < 4 * shallow;
+}
+
+} // anonymous namespace
+
+int main()
+{
+  bool linear = true;
+  linear &= run("nested calls", nestedCalls);
+  linear &= run("nested braces", nestedBraces);
+  linear &= run("pipeline", pipeline);
+
+  if (!linear)
+    std::printf("parse time grows faster than linearly with depth!\n");
+
+  return linear ? 0 : 1;
+}
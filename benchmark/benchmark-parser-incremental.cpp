@@ -0,0 +1,116 @@
+// Measures how long it takes to bring a parse tree up to date after
+// typing a character, compared with parsing the document from scratch,
+// for a generated 20,000 line file (or the files given).
+//
+//   c++ -O2 -std=c++11 -I inst/include benchmark/benchmark-parser-incremental.cpp -o benchmark-parser-incremental
+//   ./benchmark-parser-incremental [file.R ...]
+//
+// Each edit inserts a character at the start of a word on a random line,
+// and then deletes it again; both are timed.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sourcetools/parse/parse.h>
+
+namespace {
+
+using namespace sourcetools;
+
+typedef std::chrono::steady_clock Clock;
+
+std::string generate()
+{
+  std::string code;
+  char buffer[256];
+
+  for (int i = 0; i < 4000; ++i)
+  {
+    std::snprintf(buffer, sizeof(buffer),
+                  "f%d <- function(x, y = %d, ...) {\n"
+                  "  if (is.null(x)) stop(\"missing 'x'\")\n"
+                  "  z <- lapply(seq_along(x), function(i) x[[i]] * y + %d)\n"
+                  "  list(a = z, b = c(1, 2, 3), c = paste0(\"f\", %d))\n"
+                  "}\n",
+                  i, i, i, i);
+    code += buffer;
+  }
+
+  return code;
+}
+
+std::string read(const char* path)
+{
+  std::ifstream file(path);
+  std::stringstream ss;
+  ss << file.rdbuf();
+  return ss.str();
+}
+
+double milliseconds(Clock::time_point start, Clock::time_point end)
+{
+  return std::chrono::duration<double>(end - start).count() * 1E3;
+}
+
+void run(std::string code)
+{
+  // Leave room to grow, so that edits don't move the text.
+  code.reserve(code.size() * 2);
+
+  double full = 1E9;
+  for (int i = 0; i < 5; ++i)
+  {
+    Clock::time_point start = Clock::now();
+    parser::ParseStatus status;
+    parser::Parser(code).parse(&status);
+    full = std::min(full, milliseconds(start, Clock::now()));
+  }
+
+  parser::ParseStatus status;
+  parser::Parser(code).parse(&status);
+
+  std::vector<double> times;
+  std::srand(42);
+  for (int i = 0; i < 1000; ++i)
+  {
+    index_type offset = std::rand() % code.size();
+    while (offset > 0 && code[offset - 1] != ' ')
+      --offset;
+
+    Clock::time_point start = Clock::now();
+    reparse(&code, &status, offset, offset, "z");
+    Clock::time_point inserted = Clock::now();
+    reparse(&code, &status, offset, offset + 1, "");
+    Clock::time_point deleted = Clock::now();
+
+    times.push_back(milliseconds(start, inserted));
+    times.push_back(milliseconds(inserted, deleted));
+  }
+
+  std::sort(times.begin(), times.end());
+  std::size_t n = times.size();
+  std::printf("%.1f MB, %d top-level expressions\n",
+              code.size() / 1E6,
+              static_cast<int>(status.getExpressionStarts().size()));
+  std::printf("  full parse:        %8.3f ms\n", full);
+  std::printf("  re-parse (median): %8.3f ms\n", times[n / 2]);
+  std::printf("  re-parse (p90):    %8.3f ms\n", times[n * 9 / 10]);
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+    run(generate());
+
+  for (int i = 1; i < argc; ++i)
+    run(read(argv[i]));
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+// Measures the cost of parser lookahead on argument-heavy code: long
+// 'list(a = ..., b = ...)' constructors, where the parser peeks one token
+// ahead for every argument.
+//
+//   c++ -O2 -std=c++11 -I inst/include benchmark/benchmark-parser-lookahead.cpp -o benchmark-parser-lookahead
+//   ./benchmark-parser-lookahead
+//
+// Lookahead is timed in isolation (peeking past every token, by cloning
+// the tokenizer vs. through the lookahead buffer), followed by the parser
+// as a whole.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <sourcetools/tokenization/tokenization.h>
+#include <sourcetools/parse/Parser.h>
+
+namespace {
+
+using namespace sourcetools;
+
+std::string generate()
+{
+  std::string code;
+  char buffer[64];
+
+  std::srand(42);
+  for (int i = 0; i < 2000; ++i)
+  {
+    code += "config <- list(\n";
+    for (int j = 0; j < 50; ++j)
+    {
+      std::snprintf(buffer, sizeof(buffer), "  key%d = %d, # value %d\n", j, std::rand() % 100, j);
+      code += buffer;
+    }
+    code += "  name = \"last\"\n)\n";
+  }
+
+  return code;
+}
+
+template <typename F>
+double milliseconds(F f)
+{
+  double best = 1E9;
+  for (int i = 0; i < 10; ++i)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best * 1E3;
+}
+
+struct CloningLookahead
+{
+  const std::string& code;
+  index_type* pCount;
+
+  void operator()() const
+  {
+    tokenizer::SignificantTokenizer tokenizer(code.data(), code.size());
+    tokens::Token token;
+    index_type count = 0;
+    while (tokenizer.tokenize(&token))
+      count += tokenizer.peek(1).isType(tokens::OPERATOR_ASSIGN_LEFT_EQUALS);
+    *pCount = count;
+  }
+};
+
+struct BufferedLookahead
+{
+  const std::string& code;
+  index_type* pCount;
+
+  void operator()() const
+  {
+    tokenizer::BufferedTokenizer<tokenizer::SignificantTokenizer> tokenizer(code.data(), code.size());
+    tokens::Token token;
+    index_type count = 0;
+    while (tokenizer.tokenize(&token))
+      count += tokenizer.peek(1).isType(tokens::OPERATOR_ASSIGN_LEFT_EQUALS);
+    *pCount = count;
+  }
+};
+
+struct Parse
+{
+  const std::string& code;
+
+  void operator()() const
+  {
+    parser::Parser parser(code);
+    parser::ParseStatus status;
+    parser.parse(&status);
+  }
+};
+
+} // anonymous namespace
+
+int main()
+{
+  std::string code = generate();
+  std::printf("%.1f MB of list() constructors\n", code.size() / 1E6);
+
+  index_type cloned = 0, buffered = 0;
+  CloningLookahead cloning = { code, &cloned };
+  BufferedLookahead buffering = { code, &buffered };
+  Parse parse = { code };
+
+  double before = milliseconds(cloning);
+  double after = milliseconds(buffering);
+  std::printf("peek(1) per token, cloning tokenizer: %8.2f ms\n", before);
+  std::printf("peek(1) per token, lookahead buffer:  %8.2f ms (%.2fx)\n", after, before / after);
+  std::printf("parse:                                %8.2f ms\n", milliseconds(parse));
+
+  return cloned == buffered ? 0 : 1;
+}
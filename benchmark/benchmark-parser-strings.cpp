@@ -0,0 +1,127 @@
+// Measures the parser on code dominated by large multi-line string
+// literals: SQL queries and text templates, up to a hundred kilobytes
+// each, assigned, compared and piped onwards.
+//
+//   c++ -O2 -std=c++11 -I inst/include benchmark/benchmark-parser-strings.cpp -o benchmark-parser-strings
+//   ./benchmark-parser-strings
+//
+// After each string, the parser checks (once per enclosing operator)
+// whether the expression continues on the line the string ends on. The
+// tokenizer counts the newlines in each token as it goes, so these checks
+// shouldn't need to look at the string again: parsing should cost about
+// as much as tokenizing, however long the strings are.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <sourcetools/tokenization/tokenization.h>
+#include <sourcetools/parse/Parser.h>
+
+namespace {
+
+using namespace sourcetools;
+
+std::string query(int lines)
+{
+  std::string code = "\"\n";
+  char buffer[128];
+  for (int i = 0; i < lines; ++i)
+  {
+    std::snprintf(buffer, sizeof(buffer),
+                  "  SELECT col%d, SUM(value) AS total FROM table%d WHERE id > %d\n",
+                  i, std::rand() % 100, std::rand());
+    code += buffer;
+  }
+  return code + "\"";
+}
+
+std::string generate(int lines)
+{
+  std::string code;
+
+  std::srand(42);
+  for (int i = 0; i < 200; ++i)
+  {
+    code += "run <- function(con) {\n";
+    code += "  sql <- " + query(lines) + " %>%\n    glue()\n";
+    code += "  result <- dbGetQuery(con, sql) |> transform(x = 1)\n";
+    code += "  if (identical(sql, " + query(lines) + ") && nrow(result) > 0)\n";
+    code += "    body <- " + query(lines) + " |> trimws()\n";
+    code += "  " + query(lines) + " == body\n";
+    code += "}\n";
+  }
+
+  return code;
+}
+
+template <typename F>
+double milliseconds(F f)
+{
+  double best = 1E9;
+  for (int i = 0; i < 10; ++i)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best * 1E3;
+}
+
+struct Tokenize
+{
+  const std::string& code;
+
+  void operator()() const
+  {
+    tokenizer::SignificantTokenizer tokenizer(code.data(), code.size());
+    tokens::Token token;
+    while (tokenizer.tokenize(&token))
+    {
+    }
+  }
+};
+
+struct Parse
+{
+  const std::string& code;
+
+  void operator()() const
+  {
+    parser::Parser parser(code);
+    parser::ParseStatus status;
+    parser.parse(&status);
+  }
+};
+
+} // anonymous namespace
+
+int main()
+{
+  double shortest = 0, longest = 0;
+  for (int lines = 1; lines <= 1000; lines *= 10)
+  {
+    std::string code = generate(lines);
+    Tokenize tokenize = { code };
+    Parse parse = { code };
+
+    double tokenizing = milliseconds(tokenize);
+    double parsing = milliseconds(parse);
+    std::printf("%4d-line strings (%6.1f MB): tokenize %8.2f ms, parse %8.2f ms (%.2fx)\n",
+                lines, code.size() / 1E6, tokenizing, parsing, parsing / tokenizing);
+
+    if (lines == 1)
+      shortest = parsing / tokenizing;
+    longest = parsing / tokenizing;
+  }
+
+  // With longer strings there are fewer tokens per byte, so parsing
+  // should get cheaper relative to tokenizing, not dearer.
+  bool scales = longest < shortest / 2;
+  if (!scales)
+    std::printf("parse time grows with the length of strings!\n");
+
+  return scales ? 0 : 1;
+}
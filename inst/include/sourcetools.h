@@ -4,6 +4,7 @@
 #include <sourcetools/core/core.h>
 #include <sourcetools/platform/platform.h>
 #include <sourcetools/collection/collection.h>
+#include <sourcetools/simd/simd.h>
 #include <sourcetools/utf8/utf8.h>
 #include <sourcetools/cursor/cursor.h>
 #include <sourcetools/r/r.h>
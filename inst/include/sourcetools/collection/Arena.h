@@ -0,0 +1,169 @@
+#ifndef SOURCETOOLS_COLLECTION_ARENA_H
+#define SOURCETOOLS_COLLECTION_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <sourcetools/core/core.h>
+
+namespace sourcetools {
+namespace collections {
+
+// A bump allocator: memory is handed out from large blocks, and is only
+// released (all at once) when the arena is destroyed. Destructors of
+// objects placed in an arena are never run, so they should only own
+// memory that also comes from the arena.
+class Arena : noncopyable
+{
+public:
+
+  static const std::size_t BLOCK_SIZE = 64 * 1024;
+  static const std::size_t ALIGNMENT = 16;
+
+  Arena()
+    : pCursor_(NULL),
+      remaining_(0),
+      bytes_(0)
+  {
+  }
+
+  ~Arena()
+  {
+    for (std::vector<char*>::iterator it = blocks_.begin();
+         it != blocks_.end();
+         ++it)
+    {
+      std::free(*it);
+    }
+  }
+
+  void* allocate(std::size_t n)
+  {
+    n = (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    bytes_ += n;
+
+    if (UNLIKELY(n > remaining_))
+    {
+      // Give large requests a block of their own, so that they don't
+      // waste what's left of the current block.
+      if (n > BLOCK_SIZE / 4)
+        return allocateBlock(n);
+
+      pCursor_ = allocateBlock(BLOCK_SIZE);
+      remaining_ = BLOCK_SIZE;
+    }
+
+    char* result = pCursor_;
+    pCursor_ += n;
+    remaining_ -= n;
+    return result;
+  }
+
+  // Take ownership of the memory allocated by 'pOther', which is left
+  // empty; whatever was allocated from it now lives as long as we do.
+  void adopt(Arena* pOther)
+  {
+    blocks_.insert(blocks_.end(), pOther->blocks_.begin(), pOther->blocks_.end());
+    bytes_ += pOther->bytes_;
+
+    pOther->blocks_.clear();
+    pOther->pCursor_ = NULL;
+    pOther->remaining_ = 0;
+    pOther->bytes_ = 0;
+  }
+
+  // The number of blocks allocated from the system, and the number of
+  // bytes handed out from them.
+  std::size_t blocks() const { return blocks_.size(); }
+  std::size_t bytes() const { return bytes_; }
+
+private:
+
+  char* allocateBlock(std::size_t n)
+  {
+    char* pBlock = static_cast<char*>(std::malloc(n));
+    if (pBlock == NULL)
+      throw std::bad_alloc();
+
+    blocks_.push_back(pBlock);
+    return pBlock;
+  }
+
+  std::vector<char*> blocks_;
+  char* pCursor_;
+  std::size_t remaining_;
+  std::size_t bytes_;
+};
+
+// An allocator for standard containers that draws from an arena. Memory
+// is never returned to the arena, so containers that grow leave their
+// old storage behind until the arena is destroyed.
+template <typename T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+
+  template <typename U>
+  struct rebind
+  {
+    typedef ArenaAllocator<U> other;
+  };
+
+  explicit ArenaAllocator(Arena* pArena)
+    : pArena_(pArena)
+  {
+  }
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other)
+    : pArena_(other.arena())
+  {
+  }
+
+  pointer allocate(size_type n, const void* = NULL)
+  {
+    return static_cast<pointer>(pArena_->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(pointer, size_type)
+  {
+  }
+
+  void construct(pointer p, const T& value) { new (p) T(value); }
+  void destroy(pointer p) { p->~T(); }
+
+  pointer address(reference value) const { return &value; }
+  const_pointer address(const_reference value) const { return &value; }
+  size_type max_size() const { return static_cast<size_type>(-1) / sizeof(T); }
+
+  Arena* arena() const { return pArena_; }
+
+private:
+  Arena* pArena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+{
+  return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+{
+  return lhs.arena() != rhs.arena();
+}
+
+} // namespace collections
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_COLLECTION_ARENA_H */
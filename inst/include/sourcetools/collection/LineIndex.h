@@ -0,0 +1,224 @@
+#ifndef SOURCETOOLS_COLLECTION_LINE_INDEX_H
+#define SOURCETOOLS_COLLECTION_LINE_INDEX_H
+
+#include <vector>
+#include <algorithm>
+
+#include <sourcetools/core/config.h>
+#include <sourcetools/simd/simd.h>
+#include <sourcetools/utf8/utf8.h>
+#include <sourcetools/collection/Position.h>
+#include <sourcetools/collection/Range.h>
+
+namespace sourcetools {
+namespace collections {
+
+// The unit in which a column is counted: bytes (as the tokenizer tracks
+// them), Unicode code points, or UTF-16 code units (as used by LSP).
+enum ColumnUnit
+{
+  COLUMN_BYTES,
+  COLUMN_CODE_POINTS,
+  COLUMN_UTF16
+};
+
+// Records the byte offset at which each line of a document starts, so
+// that a byte offset can be mapped to a (row, column) position with a
+// binary search. This lets the tokenizer skip position tracking entirely
+// when positions are only needed for a handful of tokens (e.g. those
+// reported in errors).
+//
+// The same scan notes which lines contain non-ASCII bytes, and validates
+// them as UTF-8. Columns in code points or UTF-16 units then cost nothing
+// extra on ASCII lines, and a scan of the line's prefix otherwise. The
+// index keeps a pointer to the text, which must outlive it.
+class LineIndex
+{
+public:
+
+  LineIndex()
+    : text_(NULL),
+      n_(0),
+      starts_(1, 0),
+      malformed_(-1)
+  {
+  }
+
+  LineIndex(const char* text, index_type n)
+    : text_(text),
+      n_(n),
+      starts_(1, 0),
+      malformed_(-1)
+  {
+    const char* end = text + n;
+    const char* it = text;
+    while (true)
+    {
+      it = simd::findNonAscii(it, end, '\n');
+      if (it == end)
+        break;
+
+      if (*it == '\n')
+      {
+        starts_.push_back(it - text + 1);
+        ++it;
+        continue;
+      }
+
+      index_type row = starts_.size() - 1;
+      if (multibyteRows_.empty() || multibyteRows_.back() != row)
+        multibyteRows_.push_back(row);
+
+      index_type length = utf8::sequenceLength(it, end);
+      if (length == 0)
+      {
+        if (malformed_ == -1)
+          malformed_ = it - text;
+        length = 1;
+      }
+
+      it += length;
+    }
+  }
+
+  // Whether the text is well-formed UTF-8; if not, 'malformed()' gives the
+  // offset of the first malformed byte.
+  bool valid() const { return malformed_ == -1; }
+  index_type malformed() const { return malformed_; }
+
+  index_type rows() const { return starts_.size(); }
+  index_type start(index_type row) const { return starts_[row]; }
+
+  index_type row(index_type offset) const
+  {
+    std::vector<index_type>::const_iterator it =
+      std::upper_bound(starts_.begin(), starts_.end(), offset);
+    return it - starts_.begin() - 1;
+  }
+
+  Position position(index_type offset) const
+  {
+    index_type row = this->row(offset);
+    return Position(row, offset - starts_[row]);
+  }
+
+  Range range(index_type begin, index_type end) const
+  {
+    return Range(position(begin), position(end));
+  }
+
+  index_type offset(const Position& position) const
+  {
+    return starts_[position.row] + position.column;
+  }
+
+  // As above, with columns counted in 'unit'.
+  Position position(index_type offset, ColumnUnit unit) const
+  {
+    index_type row = this->row(offset);
+    index_type start = starts_[row];
+    if (unit == COLUMN_BYTES || !isMultibyte(row))
+      return Position(row, offset - start);
+
+    index_type codePoints, units;
+    utf8::count(text_ + start, text_ + offset, &codePoints, &units);
+    return Position(row, unit == COLUMN_UTF16 ? units : codePoints);
+  }
+
+  Range range(index_type begin, index_type end, ColumnUnit unit) const
+  {
+    return Range(position(begin, unit), position(end, unit));
+  }
+
+  index_type offset(const Position& position, ColumnUnit unit) const
+  {
+    index_type start = starts_[position.row];
+    if (unit == COLUMN_BYTES || !isMultibyte(position.row))
+      return start + position.column;
+
+    const char* it = utf8::advance(
+      text_ + start, text_ + n_, position.column, unit == COLUMN_UTF16);
+    return it - text_;
+  }
+
+  // Maps a run of ascending offsets (e.g. those of a document's tokens) to
+  // positions, counting each column on from the previous lookup on the
+  // same line, rather than from the start of the line, so that a line full
+  // of non-ASCII text is only scanned once.
+  class Cursor
+  {
+  public:
+
+    Cursor(const LineIndex& index, ColumnUnit unit)
+      : index_(index),
+        unit_(unit),
+        row_(-1),
+        limit_(0),
+        offset_(0),
+        column_(0),
+        multibyte_(false)
+    {
+    }
+
+    Position position(index_type offset)
+    {
+      if (row_ == -1 || offset < offset_ || offset >= limit_)
+        return seek(offset);
+
+      if (unit_ == COLUMN_BYTES || !multibyte_)
+      {
+        column_ += offset - offset_;
+      }
+      else
+      {
+        index_type codePoints, units;
+        utf8::count(index_.text_ + offset_, index_.text_ + offset, &codePoints, &units);
+        column_ += unit_ == COLUMN_UTF16 ? units : codePoints;
+      }
+
+      offset_ = offset;
+      return Position(row_, column_);
+    }
+
+  private:
+
+    Position seek(index_type offset)
+    {
+      Position position = index_.position(offset, unit_);
+      row_ = position.row;
+      limit_ = row_ + 1 < index_.rows() ? index_.start(row_ + 1) : index_.n_ + 1;
+      offset_ = offset;
+      column_ = position.column;
+      multibyte_ = index_.isMultibyte(row_);
+      return position;
+    }
+
+    const LineIndex& index_;
+    ColumnUnit unit_;
+    index_type row_;
+    index_type limit_;
+    index_type offset_;
+    index_type column_;
+    bool multibyte_;
+  };
+
+private:
+
+  friend class Cursor;
+
+  bool isMultibyte(index_type row) const
+  {
+    return std::binary_search(multibyteRows_.begin(), multibyteRows_.end(), row);
+  }
+
+  const char* text_;
+  index_type n_;
+  std::vector<index_type> starts_;
+  std::vector<index_type> multibyteRows_;
+  index_type malformed_;
+};
+
+} // namespace collections
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_COLLECTION_LINE_INDEX_H */
@@ -0,0 +1,151 @@
+#ifndef SOURCETOOLS_COLLECTION_SYMBOL_TABLE_H
+#define SOURCETOOLS_COLLECTION_SYMBOL_TABLE_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sourcetools/core/core.h>
+
+namespace sourcetools {
+namespace collections {
+
+// A dense id for an interned symbol: the n-th distinct symbol seen by a
+// table gets id n.
+typedef unsigned int SymbolId;
+static const SymbolId NO_SYMBOL = static_cast<SymbolId>(-1);
+
+// Interns symbol names, so that each distinct name is hashed and copied
+// once; afterwards, symbols can be compared (and used as keys) through
+// their ids. The table is an open-addressing hash table over the ids,
+// with the names stored alongside in id order.
+//
+// A table isn't safe to share between threads while interning.
+class SymbolTable
+{
+public:
+
+  static const index_type INITIAL_CAPACITY = 256;
+
+  SymbolTable()
+    : slots_(INITIAL_CAPACITY, 0)
+  {
+  }
+
+  SymbolId intern(const char* name, index_type n)
+  {
+    unsigned int hash = hashOf(name, n);
+    index_type mask = utils::size(slots_) - 1;
+    for (index_type i = hash & mask;; i = (i + 1) & mask)
+    {
+      if (slots_[i] == 0)
+      {
+        SymbolId id = static_cast<SymbolId>(names_.size());
+        names_.push_back(std::string(name, n));
+        hashes_.push_back(hash);
+        slots_[i] = id + 1;
+
+        if (2 * names_.size() > slots_.size())
+          grow();
+
+        return id;
+      }
+
+      SymbolId id = slots_[i] - 1;
+      if (hashes_[id] == hash && equal(names_[id], name, n))
+        return id;
+    }
+  }
+
+  SymbolId intern(const std::string& name)
+  {
+    return intern(name.data(), utils::size(name));
+  }
+
+  // Returns the id of 'name', or NO_SYMBOL if it hasn't been interned.
+  SymbolId find(const char* name, index_type n) const
+  {
+    unsigned int hash = hashOf(name, n);
+    index_type mask = utils::size(slots_) - 1;
+    for (index_type i = hash & mask; slots_[i] != 0; i = (i + 1) & mask)
+    {
+      SymbolId id = slots_[i] - 1;
+      if (hashes_[id] == hash && equal(names_[id], name, n))
+        return id;
+    }
+
+    return NO_SYMBOL;
+  }
+
+  SymbolId find(const std::string& name) const
+  {
+    return find(name.data(), utils::size(name));
+  }
+
+  const std::string& name(SymbolId id) const { return names_[id]; }
+  index_type size() const { return utils::size(names_); }
+
+private:
+
+  // FNV-1a.
+  static unsigned int hashOf(const char* name, index_type n)
+  {
+    unsigned int hash = 2166136261u;
+    for (index_type i = 0; i < n; ++i)
+    {
+      hash ^= static_cast<unsigned char>(name[i]);
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  static bool equal(const std::string& lhs, const char* rhs, index_type n)
+  {
+    return utils::size(lhs) == n && std::memcmp(lhs.data(), rhs, n) == 0;
+  }
+
+  void grow()
+  {
+    std::vector<SymbolId> slots(slots_.size() * 2, 0);
+    index_type mask = utils::size(slots) - 1;
+    for (SymbolId id = 0; id < names_.size(); ++id)
+    {
+      index_type i = hashes_[id] & mask;
+      while (slots[i] != 0)
+        i = (i + 1) & mask;
+      slots[i] = id + 1;
+    }
+
+    slots_.swap(slots);
+  }
+
+  std::vector<SymbolId> slots_;
+  std::vector<std::string> names_;
+  std::vector<unsigned int> hashes_;
+};
+
+// A set of symbols from one table, kept as a bitmap over their ids.
+class SymbolSet
+{
+public:
+
+  void insert(SymbolId id)
+  {
+    if (id >= members_.size())
+      members_.resize(id + 1);
+    members_[id] = true;
+  }
+
+  bool contains(SymbolId id) const
+  {
+    return id < members_.size() && members_[id];
+  }
+
+private:
+  std::vector<bool> members_;
+};
+
+} // namespace collections
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_COLLECTION_SYMBOL_TABLE_H */
@@ -3,5 +3,7 @@
 
 #include <sourcetools/collection/Position.h>
 #include <sourcetools/collection/Range.h>
+#include <sourcetools/collection/LineIndex.h>
+#include <sourcetools/collection/SymbolTable.h>
 
 #endif /* SOURCETOOLS_COLLECTION_COLLECTION_H */
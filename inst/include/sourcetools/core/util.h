@@ -51,6 +51,32 @@ private:
   T* pData_;
 };
 
+// A view of 'size()' bytes of text owned by someone else.
+class StringView
+{
+public:
+  StringView()
+    : begin_(NULL), size_(0)
+  {
+  }
+
+  StringView(const char* begin, index_type size)
+    : begin_(begin), size_(size)
+  {
+  }
+
+  const char* begin() const { return begin_; }
+  const char* end() const { return begin_ + size_; }
+  index_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  std::string str() const { return std::string(begin_, size_); }
+
+private:
+  const char* begin_;
+  index_type size_;
+};
+
 namespace utils {
 
 inline bool isWhitespace(char ch)
@@ -3,6 +3,7 @@
 
 #include <sourcetools/core/macros.h>
 #include <sourcetools/collection/Position.h>
+#include <sourcetools/simd/simd.h>
 
 namespace sourcetools {
 namespace cursors {
@@ -11,11 +12,28 @@ class TextCursor
 {
 public:
 
-  TextCursor(const char* text, index_type n)
+  // When 'trackPositions' is false, only the byte offset is maintained
+  // and 'position()' is left at (-1, -1); positions can instead be
+  // recovered on demand with a 'collections::LineIndex'.
+  TextCursor(const char* text, index_type n, bool trackPositions = true)
       : text_(text),
         n_(n),
         offset_(0),
-        position_(0, 0)
+        position_(trackPositions ? 0 : -1, trackPositions ? 0 : -1),
+        trackPositions_(trackPositions)
+  {
+  }
+
+  TextCursor(const char* text,
+             index_type n,
+             index_type offset,
+             const collections::Position& position,
+             bool trackPositions = true)
+      : text_(text),
+        n_(n),
+        offset_(offset),
+        position_(trackPositions ? position : collections::Position(-1, -1)),
+        trackPositions_(trackPositions)
   {
   }
 
@@ -29,7 +47,13 @@ public:
 
   void advance(index_type times = 1)
   {
-    for (index_type i = 0; i < times; ++i) {
+    if (!trackPositions_) {
+      if (times > 0)
+        offset_ += times;
+      return;
+    }
+
+    if (LIKELY(times == 1)) {
       if (peek() == '\n') {
         ++position_.row;
         position_.column = 0;
@@ -37,7 +61,29 @@ public:
         ++position_.column;
       }
       ++offset_;
+      return;
     }
+
+    if (times <= 0)
+      return;
+
+    // Update the position in bulk: count the newlines we're stepping
+    // over, and compute the column relative to the last one seen. Note
+    // that we may be asked to step past the end of the text; those
+    // bytes are treated as non-newline characters, as 'peek()' would.
+    const char* begin = text_ + offset_;
+    const char* end = begin + times;
+    const char* last = end < text_ + n_ ? end : text_ + n_;
+
+    index_type newlines = begin < last ? simd::count(begin, last, '\n') : 0;
+    if (newlines == 0) {
+      position_.column += times;
+    } else {
+      position_.row += newlines;
+      position_.column = end - simd::rfind(begin, last, '\n') - 1;
+    }
+
+    offset_ += times;
   }
 
   operator const char*() const { return text_ + offset_; }
@@ -51,11 +97,14 @@ public:
   const char* begin() const { return text_; }
   const char* end() const { return text_ + n_; }
 
+  bool tracksPositions() const { return trackPositions_; }
+
 private:
   const char* text_;
   index_type n_;
   index_type offset_;
   collections::Position position_;
+  bool trackPositions_;
 };
 
 } // namespace cursors
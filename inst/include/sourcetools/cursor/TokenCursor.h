@@ -10,19 +10,25 @@
 
 #include <sourcetools/collection/Position.h>
 #include <sourcetools/tokenization/Token.h>
+#include <sourcetools/tokenization/TokenBuffer.h>
 
 namespace sourcetools {
 namespace cursors {
 
-class TokenCursor {
+// A cursor over a sequence of tokens; either a 'std::vector<Token>' or a
+// 'tokens::TokenBuffer'. Tokens are returned as 'Tokens::const_reference';
+// i.e. by reference for vectors, and by value for token buffers.
+template <typename Tokens>
+class BasicTokenCursor {
 
 private:
   typedef collections::Position Position;
   typedef tokens::Token Token;
+  typedef typename Tokens::const_reference TokenReference;
 
 public:
 
-  TokenCursor(const std::vector<Token>& tokens)
+  BasicTokenCursor(const Tokens& tokens)
     : tokens_(tokens),
       offset_(0),
       n_(tokens.size()),
@@ -69,7 +75,7 @@ public:
     return true;
   }
 
-  const Token& peekFwd(index_type offset = 1) const
+  TokenReference peekFwd(index_type offset = 1) const
   {
     index_type index = offset_ + offset;
     if (UNLIKELY(index >= n_))
@@ -78,7 +84,7 @@ public:
     return tokens_[index];
   }
 
-  const Token& peekBwd(index_type offset = 1) const
+  TokenReference peekBwd(index_type offset = 1) const
   {
     if (UNLIKELY(offset > offset_))
       return noSuchToken_;
@@ -87,14 +93,14 @@ public:
     return tokens_[index];
   }
 
-  const Token& currentToken() const
+  TokenReference currentToken() const
   {
     if (UNLIKELY(offset_ >= n_))
       return noSuchToken_;
     return tokens_[offset_];
   }
 
-  operator const Token&() const { return currentToken(); }
+  operator TokenReference() const { return currentToken(); }
 
   bool fwdOverWhitespace()
   {
@@ -144,20 +150,20 @@ public:
     return true;
   }
 
-  const Token& nextSignificantToken(index_type times = 1) const
+  Token nextSignificantToken(index_type times = 1) const
   {
-    TokenCursor clone(*this);
+    BasicTokenCursor clone(*this);
     for (index_type i = 0; i < times; ++i)
       clone.moveToNextSignificantToken();
-    return clone;
+    return clone.currentToken();
   }
 
-  const Token& previousSignificantToken(index_type times = 1) const
+  Token previousSignificantToken(index_type times = 1) const
   {
-    TokenCursor clone(*this);
+    BasicTokenCursor clone(*this);
     for (index_type i = 0; i < times; ++i)
       clone.moveToPreviousSignificantToken();
-    return clone;
+    return clone.currentToken();
   }
 
   bool moveToPosition(index_type row, index_type column)
@@ -170,7 +176,7 @@ public:
     if (UNLIKELY(n_ == 0))
       return false;
 
-    if (UNLIKELY(tokens_[n_ - 1].position() <= target))
+    if (UNLIKELY(positionAt(n_ - 1) <= target))
     {
       offset_ = n_ - 1;
       return true;
@@ -183,7 +189,7 @@ public:
     while (true)
     {
       offset = (start + end) / 2;
-      const Position& current = tokens_[offset].position();
+      Position current = positionAt(offset);
 
       if (current == target || start == end)
         break;
@@ -255,13 +261,13 @@ public:
     if (!isLeftBracket(currentToken()))
       return false;
 
-    TokenType lhs = currentToken().type();
+    TokenType lhs = type();
     TokenType rhs = complement(lhs);
     index_type balance = 1;
 
     while (moveToNextSignificantToken())
     {
-      TokenType type = currentToken().type();
+      TokenType type = this->type();
       balance += type == lhs;
       balance -= type == rhs;
       if (balance == 0) return true;
@@ -276,13 +282,13 @@ public:
     if (!isRightBracket(currentToken()))
       return false;
 
-    TokenType lhs = currentToken().type();
+    TokenType lhs = type();
     TokenType rhs = complement(lhs);
     index_type balance = 1;
 
     while (moveToPreviousSignificantToken())
     {
-      TokenType type = currentToken().type();
+      TokenType type = this->type();
       balance += type == lhs;
       balance -= type == rhs;
       if (balance == 0) return true;
@@ -291,13 +297,19 @@ public:
     return false;
   }
 
-  friend std::ostream& operator<<(std::ostream& os, const TokenCursor& cursor)
+  friend std::ostream& operator<<(std::ostream& os, const BasicTokenCursor& cursor)
   {
     return os << toString(cursor.currentToken());
   }
 
-  tokens::TokenType type() const { return currentToken().type(); }
-  bool isType(tokens::TokenType type) const { return currentToken().isType(type); }
+  tokens::TokenType type() const
+  {
+    if (UNLIKELY(offset_ >= n_))
+      return noSuchToken_.type();
+    return typeAt(tokens_, offset_);
+  }
+
+  bool isType(tokens::TokenType type) const { return this->type() == type; }
   collections::Position position() const { return currentToken().position(); }
   index_type offset() const { return offset_; }
   index_type row() const { return currentToken().row(); }
@@ -306,16 +318,45 @@ public:
 
 private:
 
-  const std::vector<Token>& tokens_;
+  static tokens::TokenType typeAt(const std::vector<Token>& tokens, index_type i)
+  {
+    return tokens[i].type();
+  }
+
+  static tokens::TokenType typeAt(const tokens::TokenBuffer& tokens, index_type i)
+  {
+    return tokens.type(i);
+  }
+
+  static Position positionAt(const std::vector<Token>& tokens, index_type i)
+  {
+    return tokens[i].position();
+  }
+
+  static Position positionAt(const tokens::TokenBuffer& tokens, index_type i)
+  {
+    return tokens.position(i);
+  }
+
+  Position positionAt(index_type i) const
+  {
+    return positionAt(tokens_, i);
+  }
+
+  const Tokens& tokens_;
   index_type offset_;
   index_type n_;
   Token noSuchToken_;
 
 };
 
+typedef BasicTokenCursor< std::vector<tokens::Token> > TokenCursor;
+typedef BasicTokenCursor<tokens::TokenBuffer> TokenBufferCursor;
+
 } // namespace cursors
 
-inline std::string toString(const cursors::TokenCursor& cursor)
+template <typename Tokens>
+inline std::string toString(const cursors::BasicTokenCursor<Tokens>& cursor)
 {
   return toString(cursor.currentToken());
 }
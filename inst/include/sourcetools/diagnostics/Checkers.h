@@ -155,7 +155,7 @@ public:
 
     if (parentToken.isType(tokens::LBRACE))
     {
-      const std::vector<ParseNode*>& siblings = pNode->parent()->children();
+      const ParseNode::Children& siblings = pNode->parent()->children();
       if (pNode == siblings[siblings.size() - 1])
         return;
     }
@@ -215,6 +215,8 @@ public:
 
 private:
 
+  // Names defined in a scope. Symbols interned by the parser are tracked
+  // by id; anything else (e.g. strings used as assignment targets) by name.
   class Context
   {
   public:
@@ -225,12 +227,21 @@ private:
 
     void add(const Token& token)
     {
-      values_.insert(token.contents());
+      if (token.symbol() != collections::NO_SYMBOL)
+        symbols_.insert(token.symbol());
+      else
+        values_.insert(token.contents());
     }
 
-    bool contains(const std::string& contents) const
+    bool contains(const Token& token) const
     {
-      return values_.count(contents);
+      if (token.symbol() != collections::NO_SYMBOL &&
+          symbols_.contains(token.symbol()))
+      {
+        return true;
+      }
+
+      return !values_.empty() && values_.count(token.contents());
     }
 
     index_type depth() const
@@ -239,6 +250,7 @@ private:
     }
 
   private:
+    collections::SymbolSet symbols_;
     std::set<std::string> values_;
     index_type depth_;
   };
@@ -253,8 +265,8 @@ private:
     stack_.push_back(Context(depth));
 
     ParseNode* pFormals = pNode->children()[0];
-    const std::vector<ParseNode*>& children = pFormals->children();
-    for (std::vector<ParseNode*>::const_iterator it = children.begin();
+    const ParseNode::Children& children = pFormals->children();
+    for (ParseNode::Children::const_iterator it = children.begin();
          it != children.end();
          ++it)
     {
@@ -285,18 +297,17 @@ private:
     if (!token.isType(tokens::SYMBOL))
       return;
 
-    std::string contents = token.contents();
     for (std::vector<Context>::const_iterator it = stack_.begin();
          it != stack_.end();
          ++it)
     {
-      if (it->contains(contents))
+      if (it->contains(token))
       {
         return;
       }
     }
 
-    if (objects_.count(token.contents()))
+    if (isOnSearchPath(token))
       return;
 
     collections::Range range(token.position(), token.position() + token.size());
@@ -305,8 +316,26 @@ private:
         range);
   }
 
+  // Search path lookups are cached per symbol id: 1 if the symbol is
+  // defined on the search path, -1 if not, 0 if not yet looked up.
+  bool isOnSearchPath(const Token& token)
+  {
+    collections::SymbolId id = token.symbol();
+    if (id == collections::NO_SYMBOL)
+      return objects_.count(token.contents());
+
+    if (id >= searchPath_.size())
+      searchPath_.resize(id + 1, 0);
+
+    if (searchPath_[id] == 0)
+      searchPath_[id] = objects_.count(token.contents()) ? 1 : -1;
+
+    return searchPath_[id] == 1;
+  }
+
   std::vector<Context> stack_;
   std::set<std::string> objects_;
+  std::vector<signed char> searchPath_;
 
 };
 
@@ -51,6 +51,17 @@ public:
     diagnostics_.push_back(Diagnostic(type, message, range));
   }
 
+  // Add a diagnostic spanning the bytes [begin, end), resolving its
+  // range through a line index.
+  void add(DiagnosticType type,
+           const std::string& message,
+           index_type begin,
+           index_type end,
+           const collections::LineIndex& index)
+  {
+    add(type, message, index.range(begin, end));
+  }
+
   void addError(const std::string& message, const Range& range)
   {
     add(DIAGNOSTIC_ERROR, message, range);
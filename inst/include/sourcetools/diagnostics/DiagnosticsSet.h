@@ -58,7 +58,7 @@ private:
       (*it)->apply(pNode, &diagnostics_, depth);
     }
 
-    for (std::vector<ParseNode*>::const_iterator it = pNode->children().begin();
+    for (ParseNode::Children::const_iterator it = pNode->children().begin();
          it != pNode->children().end();
          ++it)
     {
@@ -0,0 +1,203 @@
+#ifndef SOURCETOOLS_PARSE_FLAT_TREE_H
+#define SOURCETOOLS_PARSE_FLAT_TREE_H
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/collection/collection.h>
+#include <sourcetools/tokenization/Token.h>
+#include <sourcetools/parse/ParseNode.h>
+
+namespace sourcetools {
+namespace parser {
+
+// A node of a 'FlatTree'. Nodes refer to their token, and to each other,
+// by offset and index rather than by pointer, so that a tree's nodes can
+// be copied (or written out) as a block of memory.
+struct FlatNode
+{
+  tokens::TokenType type;
+
+  // The node's token, as a byte offset and size within the document
+  // (an offset of -1 for tokens synthesized by the parser, e.g. ROOT).
+  index_type offset;
+  index_type size;
+
+  // Indices of related nodes, or 'FlatTree::NONE'.
+  index_type parent;
+  index_type firstChild;
+  index_type nextSibling;
+
+  // The bytes spanned by the node and its children, as [begin, end);
+  // both are -1 for a synthesized node without children.
+  index_type begin;
+  index_type end;
+};
+
+// A parse tree, stored as one contiguous array of compact nodes in
+// pre-order: a node's children follow it, and each child is followed by
+// its own subtree before its next sibling. A node takes 32 bytes, where
+// a 'ParseNode' takes over 100 plus its child array.
+//
+// Nodes record their token as a byte offset and size, rather than as an
+// index into a vector of tokens: the parser doesn't keep such a vector,
+// and this way a token can be rebuilt (see 'token()') from the text
+// alone. Positions are resolved through a 'LineIndex' when needed.
+// 'ParseStatus' looks nodes up by position through a flat tree.
+class FlatTree
+{
+public:
+  typedef tokens::Token Token;
+  typedef collections::Range Range;
+  typedef collections::LineIndex LineIndex;
+
+  static const index_type NONE = -1;
+
+  FlatTree()
+    : text_(NULL)
+  {
+  }
+
+  FlatTree(const char* text, const ParseNode* pRoot)
+    : text_(text)
+  {
+    build(pRoot);
+  }
+
+  // Adopt nodes previously copied out of a tree for the same text.
+  FlatTree(const char* text, const FlatNode* pNodes, index_type n)
+    : text_(text),
+      nodes_(n)
+  {
+    if (n > 0)
+      std::memcpy(&nodes_[0], pNodes, n * sizeof(FlatNode));
+  }
+
+  index_type size() const { return utils::size(nodes_); }
+  bool empty() const { return nodes_.empty(); }
+
+  const FlatNode& operator[](index_type i) const { return nodes_[i]; }
+  const FlatNode* data() const { return nodes_.empty() ? NULL : &nodes_[0]; }
+  const char* text() const { return text_; }
+
+  // Nodes are materialized into tokens without positions; resolve them
+  // through a line index if needed (see 'range()').
+  Token token(index_type i) const
+  {
+    const FlatNode& node = nodes_[i];
+    if (node.offset == -1)
+      return Token(node.type);
+
+    const char* begin = text_ + node.offset;
+    return Token(begin,
+                 begin + node.size,
+                 node.offset,
+                 collections::Position(-1, -1),
+                 node.type);
+  }
+
+  Range range(index_type i, const LineIndex& index) const
+  {
+    return index.range(nodes_[i].begin, nodes_[i].end);
+  }
+
+  // Returns the innermost node whose span contains 'offset', or NONE.
+  index_type find(index_type offset) const
+  {
+    index_type result = NONE;
+    for (index_type i = nodes_.empty() ? NONE : 0; i != NONE;)
+    {
+      const FlatNode& node = nodes_[i];
+      if (offset < node.begin || offset >= node.end)
+      {
+        i = node.nextSibling;
+        continue;
+      }
+
+      result = i;
+      i = node.firstChild;
+    }
+
+    return result;
+  }
+
+private:
+
+  void build(const ParseNode* pRoot)
+  {
+    // Walk the tree with an explicit stack (deep trees are common in
+    // generated code), pushing children in reverse so that they're
+    // visited in order. 'lastChild' tracks where to link the next child.
+    std::vector<std::pair<const ParseNode*, index_type> > stack;
+    std::vector<index_type> lastChild;
+    stack.push_back(std::make_pair(pRoot, index_type(NONE)));
+
+    while (!stack.empty())
+    {
+      const ParseNode* pNode = stack.back().first;
+      index_type parent = stack.back().second;
+      stack.pop_back();
+
+      index_type index = utils::size(nodes_);
+      nodes_.push_back(createNode(pNode, parent));
+      lastChild.push_back(index_type(NONE));
+
+      if (parent != NONE)
+      {
+        if (lastChild[parent] == NONE)
+          nodes_[parent].firstChild = index;
+        else
+          nodes_[lastChild[parent]].nextSibling = index;
+        lastChild[parent] = index;
+      }
+
+      const ParseNode::Children& children = pNode->children();
+      for (index_type i = utils::size(children) - 1; i >= 0; --i)
+        stack.push_back(std::make_pair(children[i], index));
+    }
+
+    // Nodes for synthesized tokens (e.g. ROOT, or the EMPTY node holding
+    // function formals) don't know where they start; widen every span to
+    // cover its children, visiting children before their parents.
+    for (index_type i = size() - 1; i > 0; --i)
+    {
+      const FlatNode& node = nodes_[i];
+      if (node.begin == -1)
+        continue;
+
+      FlatNode& parent = nodes_[node.parent];
+      if (parent.begin == -1 || node.begin < parent.begin)
+        parent.begin = node.begin;
+      if (parent.end == -1 || node.end > parent.end)
+        parent.end = node.end;
+    }
+  }
+
+  static FlatNode createNode(const ParseNode* pNode, index_type parent)
+  {
+    const Token& token = pNode->token();
+    const Token& begin = pNode->begin();
+    const Token& end = pNode->end();
+
+    FlatNode node;
+    node.type = token.type();
+    node.offset = token.offset();
+    node.size = token.offset() == -1 ? 0 : token.size();
+    node.parent = parent;
+    node.firstChild = NONE;
+    node.nextSibling = NONE;
+    node.begin = begin.offset();
+    node.end = end.offset() == -1 ? -1 : end.offset() + end.size();
+    return node;
+  }
+
+  const char* text_;
+  std::vector<FlatNode> nodes_;
+};
+
+} // namespace parser
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_PARSE_FLAT_TREE_H */
@@ -0,0 +1,349 @@
+#ifndef SOURCETOOLS_PARSE_INCREMENTAL_PARSER_H
+#define SOURCETOOLS_PARSE_INCREMENTAL_PARSER_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/collection/collection.h>
+#include <sourcetools/tokenization/tokenization.h>
+
+#include <sourcetools/parse/ParseNode.h>
+#include <sourcetools/parse/ParseError.h>
+#include <sourcetools/parse/ParseStatus.h>
+#include <sourcetools/parse/Parser.h>
+
+namespace sourcetools {
+namespace parser {
+
+// Updates a parse tree after an edit, re-parsing only the top-level
+// expressions the edit can affect.
+//
+// A top-level expression depends on its own tokens, and on the first
+// token of the next expression (where the parser decides that it ends),
+// which the tokenizer decides on by looking at most two bytes past its end.
+// So expressions are kept as they are while the expression after next
+// starts two or more bytes before the edit. We restart the parser at the
+// first expression that isn't kept, from the position recorded for it (see
+// 'ExpressionStart'), and re-parse until the parser is about to start an
+// expression where an old expression started, past the edited text, with
+// no brackets open in either case. The tokenizer is then in the state it
+// was in before, and so is the parser: from there on, the old expressions
+// are still valid and only need to be shifted.
+//
+// Shifting every node after the edit would make each re-parse take time
+// proportional to the rest of the document, so we only record how far
+// each of those expressions has moved (see 'ExpressionStart'); its nodes
+// are updated when it is next asked for (see 'ParseStatus::expression()').
+// Expressions on the row where the edit ends also move sideways, by an
+// amount that depends on the row, so those few are updated straight away.
+// If the edit moves the text, every expression is marked for updating in
+// the same way.
+//
+// Nodes that are replaced stay in the status's arena until it's destroyed,
+// so a document that is edited for a long time should occasionally be
+// parsed from scratch.
+class IncrementalParser
+{
+private:
+  typedef tokens::Token Token;
+  typedef tokens::TokenType TokenType;
+  typedef collections::Position Position;
+  typedef ParseStatus::Shift Shift;
+
+  // Moves tokens into the edited text: by 'bytes' bytes and 'rows' rows
+  // (a shift not yet applied), and then by 'rowShift' rows, and also by
+  // 'columnShift' columns if they were on row 'row'.
+  class Relocation
+  {
+  public:
+    Relocation(const char* code,
+               index_type bytes,
+               index_type rows,
+               index_type row = -1,
+               index_type rowShift = 0,
+               index_type columnShift = 0)
+      : code_(code),
+        bytes_(bytes),
+        rows_(rows),
+        row_(row),
+        rowShift_(rowShift),
+        columnShift_(columnShift)
+    {
+    }
+
+    void operator()(Token* pToken) const
+    {
+      // Tokens synthesized by the parser don't refer to the text.
+      if (pToken->offset() == -1)
+        return;
+
+      pToken->move(code_, pToken->offset() + bytes_, (*this)(pToken->position()));
+    }
+
+    Position operator()(const Position& position) const
+    {
+      if (position.row == -1)
+        return position;
+
+      Position result = position;
+      result.row += rows_;
+      if (result.row == row_)
+        result.column += columnShift_;
+      result.row += rowShift_;
+      return result;
+    }
+
+  private:
+    const char* code_;
+    index_type bytes_;
+    index_type rows_;
+    index_type row_;
+    index_type rowShift_;
+    index_type columnShift_;
+  };
+
+public:
+
+  // Replace the bytes [begin, end) of '*pCode' with 'replacement', and
+  // update the tree in '*pStatus' (which must hold a parse of '*pCode') to
+  // match. If 'pTokens' isn't NULL, the tokens it holds (those of '*pCode',
+  // as from 'tokenize()') are updated too.
+  IncrementalParser(std::string* pCode,
+                    std::vector<Token>* pTokens,
+                    ParseStatus* pStatus,
+                    index_type begin,
+                    index_type end,
+                    const std::string& replacement,
+                    collections::SymbolTable* pSymbols = NULL)
+    : pCode_(pCode),
+      pTokens_(pTokens),
+      pStatus_(pStatus),
+      begin_(begin),
+      end_(end),
+      replacement_(replacement),
+      pSymbols_(pSymbols)
+  {
+  }
+
+  void run()
+  {
+    // Use the root as it is: the expressions we keep don't need updating.
+    ParseNode* pRoot = pStatus_->pRoot_;
+    std::vector<ExpressionStart>& starts = pStatus_->starts_;
+    std::vector<ParseError>& errors = pStatus_->errors_;
+    index_type count = utils::size(starts);
+
+    // Find the expressions to keep, and where to restart parsing.
+    index_type kept = keptExpressions();
+    index_type restart = kept > 0 ? starts[kept].offset : 0;
+    Position position = kept > 0 ? starts[kept].position : Position(0, 0);
+    index_type keptErrors = kept < count ?
+      starts[kept].errors :
+      utils::size(errors);
+
+    // Apply the edit (re-tokenizing, if we have tokens to update).
+    const char* previous = pCode_->data();
+    if (pTokens_ != NULL)
+      retokenize(pCode_, pTokens_, begin_, end_, replacement_);
+    else
+      pCode_->replace(begin_, end_ - begin_, replacement_);
+
+    const char* code = pCode_->data();
+    index_type n = pCode_->size();
+    index_type delta = utils::size(replacement_) - (end_ - begin_);
+    index_type editEnd = begin_ + utils::size(replacement_);
+
+    // Re-parse until we line up with the old expressions again.
+    Parser parser(code, n, restart, position, std::vector<TokenType>(), pSymbols_);
+    std::vector<ParseNode*> nodes;
+    std::vector<ExpressionStart> fresh;
+    index_type oldErrors = utils::size(errors);
+    index_type reused = kept;
+
+    while (true)
+    {
+      index_type error = utils::size(errors) - oldErrors + keptErrors;
+      ExpressionStart start = parser.expressionStart(error);
+      if (start.offset != -1 && start.offset >= editEnd)
+      {
+        while (reused < count && starts[reused].offset + delta < start.offset)
+          ++reused;
+
+        if (reused < count &&
+            starts[reused].offset + delta == start.offset &&
+            starts[reused].resumable &&
+            start.resumable)
+        {
+          position = start.position;
+          break;
+        }
+      }
+
+      ParseNode* pNode = parser.parseNext(pStatus_);
+      if (pNode == NULL)
+      {
+        reused = count;
+        break;
+      }
+
+      nodes.push_back(pNode);
+      fresh.push_back(start);
+    }
+
+    // Positions from the first reused expression on move down by the same
+    // number of rows; those on its row also move sideways.
+    index_type row = -1, rowShift = 0, columnShift = 0;
+    if (reused < count)
+    {
+      const Position& old = starts[reused].position;
+      row = old.row;
+      rowShift = position.row - old.row;
+      columnShift = position.column - old.column;
+    }
+
+    // If the text moved, every old expression needs to point into it.
+    if (code != previous)
+    {
+      for (index_type i = 0; i < count; ++i)
+        starts[i].stale = true;
+    }
+
+    // Move the old expressions that follow the edit: those starting on the
+    // row the first of them starts on now, and the rest when they're asked
+    // for.
+    const ParseNode::Children& children = pRoot->children();
+    index_type reusedErrors = reused < count ? starts[reused].errors : oldErrors;
+    index_type errorDelta = keptErrors + (utils::size(errors) - oldErrors) - reusedErrors;
+    Relocation relocation(code, delta, 0, row, rowShift, columnShift);
+    for (index_type i = reused; i < count; ++i)
+    {
+      ExpressionStart& start = starts[i];
+      start.offset += delta;
+      start.errors += errorDelta;
+
+      if (start.position.row > row)
+      {
+        start.position.row += rowShift;
+        start.shift += delta;
+        start.rows += rowShift;
+        continue;
+      }
+
+      start.position = relocation(start.position);
+      children[i]->transformTree(
+        Relocation(code, start.shift + delta, start.rows, row, rowShift, columnShift));
+      start.shift = start.rows = 0;
+      start.stale = false;
+    }
+
+    // Splice the new expressions, and their errors, in between.
+    pRoot->replace(kept, reused, nodes);
+
+    starts.erase(starts.begin() + kept, starts.begin() + reused);
+    starts.insert(starts.begin() + kept, fresh.begin(), fresh.end());
+
+    std::vector<ParseError> result(errors.begin(), errors.begin() + keptErrors);
+    if (code != previous)
+      relocate(&result, 0, keptErrors, Relocation(code, 0, 0));
+    result.insert(result.end(), errors.begin() + oldErrors, errors.end());
+    result.insert(result.end(), errors.begin() + reusedErrors, errors.begin() + oldErrors);
+    relocate(&result, utils::size(result) - (oldErrors - reusedErrors), utils::size(result),
+             relocation);
+    errors.swap(result);
+
+    pStatus_->setRoot(pRoot, code, n);
+    pStatus_->settled_ = false;
+  }
+
+private:
+
+  // The number of top-level expressions to keep: those followed by an
+  // expression whose first token is unaffected by the edit, which we know
+  // when the expression after that starts two or more bytes before the
+  // edit. (We restart from the start of the first expression that isn't
+  // kept, so it must be one we can restart from.)
+  index_type keptExpressions() const
+  {
+    const std::vector<ExpressionStart>& starts = pStatus_->starts_;
+
+    // Binary search for the number of expressions starting by then.
+    index_type target = begin_ - 2;
+    index_type lo = 0, hi = utils::size(starts);
+    while (lo < hi)
+    {
+      index_type mid = lo + (hi - lo) / 2;
+      if (starts[mid].offset <= target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    index_type kept = std::max(lo - 2, index_type(0));
+    while (kept > 0 && !starts[kept].resumable)
+      --kept;
+
+    return kept;
+  }
+
+  static void relocate(std::vector<ParseError>* pErrors,
+                       index_type first,
+                       index_type last,
+                       const Relocation& relocation)
+  {
+    for (index_type i = first; i < last; ++i)
+      (*pErrors)[i].transform(relocation);
+  }
+
+  std::string* pCode_;
+  std::vector<Token>* pTokens_;
+  ParseStatus* pStatus_;
+  index_type begin_;
+  index_type end_;
+  std::string replacement_;
+  collections::SymbolTable* pSymbols_;
+};
+
+} // namespace parser
+
+// Replace the bytes [begin, end) of '*pCode' with 'replacement', updating
+// the parse tree held by '*pStatus' to match. Only the top-level
+// expressions near the edit are re-parsed; the rest of the tree is kept,
+// and only moved into place as it's asked for.
+//
+// So after a re-parse, get the tree through 'pStatus->root()' (which
+// moves every expression into place) or 'pStatus->expression()' (which
+// moves just the one); the nodes reached through a root pointer held from
+// before may have stale offsets, positions and text, and must not be
+// walked. The nodes of replaced expressions aren't freed: each re-parse
+// adds to the status's arena, until the document is parsed from scratch.
+inline void reparse(std::string* pCode,
+                    parser::ParseStatus* pStatus,
+                    index_type begin,
+                    index_type end,
+                    const std::string& replacement,
+                    collections::SymbolTable* pSymbols = NULL)
+{
+  parser::IncrementalParser parser(pCode, NULL, pStatus, begin, end, replacement, pSymbols);
+  parser.run();
+}
+
+// As above, also updating '*pTokens' (the tokens of '*pCode'); see
+// 'retokenize()'. Unlike the tree, the tokens after the edit are all moved
+// straight away, which takes time proportional to their number.
+inline void reparse(std::string* pCode,
+                    std::vector<tokens::Token>* pTokens,
+                    parser::ParseStatus* pStatus,
+                    index_type begin,
+                    index_type end,
+                    const std::string& replacement,
+                    collections::SymbolTable* pSymbols = NULL)
+{
+  parser::IncrementalParser parser(pCode, pTokens, pStatus, begin, end, replacement, pSymbols);
+  parser.run();
+}
+
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_PARSE_INCREMENTAL_PARSER_H */
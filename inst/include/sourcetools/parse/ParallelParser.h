@@ -0,0 +1,385 @@
+#ifndef SOURCETOOLS_PARSE_PARALLEL_PARSER_H
+#define SOURCETOOLS_PARSE_PARALLEL_PARSER_H
+
+#include <vector>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/platform/platform.h>
+#include <sourcetools/platform/threads.h>
+#include <sourcetools/simd/simd.h>
+#include <sourcetools/collection/collection.h>
+#include <sourcetools/tokenization/tokenization.h>
+
+#include <sourcetools/parse/ParseNode.h>
+#include <sourcetools/parse/ParseError.h>
+#include <sourcetools/parse/ParseStatus.h>
+#include <sourcetools/parse/Parser.h>
+
+#ifdef SOURCETOOLS_COMPILER_CXX11
+# include <thread>
+#endif
+
+namespace sourcetools {
+namespace parser {
+
+// Parses a large document in parallel, producing exactly the tree (and
+// errors) that the sequential parser would.
+//
+// A pre-pass over the tokens splits the document into chunks at lines
+// that look like they start a top-level expression: outside of any
+// brackets, and not continuing the previous line (after a binary
+// operator, or the header of an 'if', 'function', and so on). The
+// tokenizer's state is known exactly at each split (the pre-pass is a
+// plain sequential tokenization, without storing the tokens), so
+// each chunk is parsed independently, into a status of its own, on the
+// guess that a top-level expression starts there. The chunks are then
+// stitched together in order. A chunk's guess was right if the previous
+// chunk's last expression ended exactly where the chunk starts. If it
+// didn't, we parse from where it did end until we reach an expression
+// the chunk parsed (from then on, its expressions are the ones the
+// sequential parser would find), or the end of the chunk.
+class ParallelParser : noncopyable
+{
+private:
+  typedef tokens::Token Token;
+  typedef tokens::TokenType TokenType;
+  typedef collections::Position Position;
+
+  struct Chunk
+  {
+    index_type begin;
+    index_type end;
+
+    // The tokenizer's state at 'begin'.
+    Position position;
+    std::vector<TokenType> stack;
+
+    ParseStatus* pStatus;
+    std::vector<ParseNode*> nodes;
+    index_type stop;
+  };
+
+public:
+
+  ParallelParser(const char* code,
+                 index_type n,
+                 index_type threads,
+                 index_type chunkSize = threads::DEFAULT_CHUNK_SIZE)
+    : code_(code),
+      n_(n),
+      threads_(threads < 1 ? 1 : threads),
+      chunkSize_(threads::chunkSize(n_, threads_, chunkSize))
+  {
+  }
+
+  ~ParallelParser()
+  {
+    for (std::size_t i = 0; i < chunks_.size(); ++i)
+      delete chunks_[i].pStatus;
+  }
+
+  // How many threads are worth using to parse 'n' bytes, given at most
+  // 'threads': no more than there are cores, and few enough that each
+  // thread gets at least 'chunkSize' bytes. (Each chunk costs a thread, a
+  // status, and stitching; and the pre-pass that splits the document is
+  // sequential.) One means the document is best parsed sequentially.
+  static index_type usefulThreads(index_type n,
+                                  index_type threads,
+                                  index_type chunkSize = threads::DEFAULT_CHUNK_SIZE)
+  {
+#ifdef SOURCETOOLS_COMPILER_CXX11
+    // The number of cores is 0 if it can't be determined.
+    index_type cores = static_cast<index_type>(std::thread::hardware_concurrency());
+    if (cores > 0 && threads > cores)
+      threads = cores;
+#else
+    threads = 1;
+#endif
+
+    if (chunkSize > 0 && threads > n / chunkSize)
+      threads = n / chunkSize;
+
+    return threads < 1 ? 1 : threads;
+  }
+
+  // Parse the document. The tree returned is owned by 'pStatus', and is
+  // freed when it's destroyed.
+  ParseNode* parse(ParseStatus* pStatus)
+  {
+    // Small documents aren't worth splitting.
+    if (threads_ == 1 || n_ <= chunkSize_)
+      return Parser(code_, n_).parse(pStatus);
+
+    split();
+
+    run(&ParallelParser::parseChunk);
+    return stitch(pStatus);
+  }
+
+private:
+
+  // The pre-pass: stream through the tokens, tracking the brackets open,
+  // and split at the first likely start of a top-level expression once a
+  // chunk is big enough.
+  void split()
+  {
+    tokenizer::Tokenizer tokenizer(code_, n_);
+    std::vector<bool> headers;
+    Token previous;
+    bool header = false;
+    index_type target = chunkSize_;
+
+    addChunk(0, Position(0, 0), std::vector<TokenType>());
+
+    Token token;
+    while (true)
+    {
+      // Note the tokenizer's state before the token, in case we split there.
+      index_type offset = tokenizer.offset();
+      Position position = tokenizer.position();
+      if (!tokenizer.tokenize(&token))
+        break;
+
+      if (tokens::isWhitespace(token) || tokens::isComment(token))
+        continue;
+
+      // (Tokens that don't change the tokenizer's stack leave it as it
+      // was before them.)
+      if (offset >= target &&
+          headers.empty() &&
+          !token.isType(tokens::LBRACKET) &&
+          !token.isType(tokens::LDBRACKET) &&
+          *token.begin() != ']' &&
+          startsExpression(previous, token, header))
+      {
+        addChunk(offset, position, tokenizer.stack());
+        target = offset + chunkSize_;
+      }
+
+      // Note whether a ')' closes the header of e.g. an 'if' or 'function',
+      // which the body can follow on the next line.
+      header = false;
+      if (tokens::isLeftBracket(token)) {
+        headers.push_back(
+          token.isType(tokens::LPAREN) &&
+          tokens::isControlFlowKeyword(previous));
+      } else if (tokens::isRightBracket(token) && !headers.empty()) {
+        header = headers.back();
+        headers.pop_back();
+      }
+
+      previous = token;
+    }
+
+    for (std::size_t i = 0; i + 1 < chunks_.size(); ++i)
+      chunks_[i].end = chunks_[i + 1].begin;
+    chunks_.back().end = n_;
+  }
+
+  static bool startsExpression(const Token& previous, const Token& token, bool header)
+  {
+    if (previous.offset() == -1 || header)
+      return false;
+
+    // The previous line must be finished ...
+    if (tokens::isOperator(previous) ||
+        tokens::isControlFlowKeyword(previous) ||
+        previous.isType(tokens::KEYWORD_ELSE) ||
+        previous.isType(tokens::COMMA))
+    {
+      return false;
+    }
+
+    // ... and not continued on this one.
+    if (token.isType(tokens::KEYWORD_ELSE))
+      return false;
+
+    return simd::find(previous.end(), token.begin(), '\n') != token.begin();
+  }
+
+  void addChunk(index_type begin,
+                const Position& position,
+                const std::vector<TokenType>& stack)
+  {
+    Chunk chunk;
+    chunk.begin = begin;
+    chunk.end = begin;
+    chunk.position = position;
+    chunk.stack = stack;
+    chunk.pStatus = NULL;
+    chunk.stop = begin;
+    chunks_.push_back(chunk);
+    chunks_.back().pStatus = new ParseStatus;
+  }
+
+  void parseChunk(Chunk* pChunk)
+  {
+    ParseStatus* pStatus = pChunk->pStatus;
+    Parser parser(code_, n_, pChunk->begin, pChunk->position, pChunk->stack);
+
+    while (true)
+    {
+      index_type offset = parser.offset();
+      if (offset == -1 || offset >= pChunk->end)
+        break;
+
+      ExpressionStart start = parser.expressionStart(utils::size(pStatus->getErrors()));
+      ParseNode* pNode = parser.parseNext(pStatus);
+      if (pNode == NULL)
+        break;
+
+      pChunk->nodes.push_back(pNode);
+      pStatus->addExpressionStart(start);
+    }
+
+    pChunk->stop = parser.offset();
+  }
+
+  ParseNode* stitch(ParseStatus* pStatus)
+  {
+    ParseNode* pRoot = ParseNode::create(pStatus->arena(), tokens::ROOT);
+
+    // Where the next top-level expression starts (or -1, once we've
+    // reached the end of the document).
+    index_type stop = chunks_[0].begin;
+    for (std::size_t i = 0; i < chunks_.size(); ++i)
+    {
+      Chunk& chunk = chunks_[i];
+      pStatus->arena()->adopt(chunk.pStatus->arena());
+      if (stop == -1)
+        continue;
+
+      const std::vector<ExpressionStart>& starts = chunk.pStatus->getExpressionStarts();
+      index_type count = utils::size(starts);
+      index_type first = find(starts, stop);
+      if (i > 0 && (first == count || starts[first].offset != stop))
+      {
+        first = resync(chunk, &stop, pRoot, pStatus);
+        if (first == count)
+          continue;
+      }
+
+      // Take the chunk's expressions from 'first' on, with their errors.
+      const std::vector<ParseError>& errors = chunk.pStatus->getErrors();
+      index_type skipped = first < count ? starts[first].errors : utils::size(errors);
+      index_type before = utils::size(pStatus->getErrors());
+      for (index_type j = first; j < count; ++j)
+      {
+        pRoot->add(chunk.nodes[j]);
+
+        ExpressionStart start = starts[j];
+        start.errors += before - skipped;
+        pStatus->addExpressionStart(start);
+      }
+
+      for (index_type j = skipped; j < utils::size(errors); ++j)
+        pStatus->addError(errors[j]);
+
+      stop = chunk.stop;
+    }
+
+    pStatus->setRoot(pRoot, code_, n_);
+    return pRoot;
+  }
+
+  // Parse, on this thread and into 'pStatus', the expressions from '*pStop'
+  // on until we reach one that 'chunk' parsed, or the chunk's end. Returns
+  // the index of that expression within the chunk; if there isn't one, the
+  // offset the parser stopped at is left in '*pStop'.
+  index_type resync(const Chunk& chunk,
+                    index_type* pStop,
+                    ParseNode* pRoot,
+                    ParseStatus* pStatus)
+  {
+    const std::vector<ExpressionStart>& starts = chunk.pStatus->getExpressionStarts();
+    index_type count = utils::size(starts);
+    index_type offset = *pStop;
+    if (offset >= chunk.end)
+      return count;
+
+    // Recover the tokenizer's state at 'offset'.
+    tokenizer::Tokenizer tokenizer(code_, n_, chunk.begin, chunk.position, chunk.stack);
+    Token token;
+    while (tokenizer.offset() < offset)
+      tokenizer.tokenize(&token);
+
+    Parser parser(code_, n_, offset, tokenizer.position(), tokenizer.stack());
+    index_type first = 0;
+    while (true)
+    {
+      offset = parser.offset();
+      if (offset == -1 || offset >= chunk.end)
+        break;
+
+      while (first < count && starts[first].offset < offset)
+        ++first;
+
+      if (first < count && starts[first].offset == offset)
+        return first;
+
+      ExpressionStart start = parser.expressionStart(utils::size(pStatus->getErrors()));
+      ParseNode* pNode = parser.parseNext(pStatus);
+      if (pNode == NULL)
+        break;
+
+      pRoot->add(pNode);
+      pStatus->addExpressionStart(start);
+    }
+
+    *pStop = parser.offset();
+    return count;
+  }
+
+  // The index of the first expression starting at or after 'offset'.
+  static index_type find(const std::vector<ExpressionStart>& starts, index_type offset)
+  {
+    index_type lo = 0, hi = utils::size(starts);
+    while (lo < hi)
+    {
+      index_type mid = lo + (hi - lo) / 2;
+      if (starts[mid].offset < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  void run(void (ParallelParser::*method)(Chunk*))
+  {
+    threads::forEach(this, method, &chunks_, threads_);
+  }
+
+  const char* code_;
+  index_type n_;
+  index_type threads_;
+  index_type chunkSize_;
+  std::vector<Chunk> chunks_;
+};
+
+} // namespace parser
+
+// Parse 'code' using up to 'threads' threads, but no more than are worth
+// using (see 'ParallelParser::usefulThreads()'): small documents, and
+// machines with a single core, are parsed sequentially. The tree returned
+// is owned by 'pStatus'. Without C++11 support, the document is always
+// parsed sequentially.
+inline parser::ParseNode* parseParallel(
+  const char* code,
+  index_type n,
+  parser::ParseStatus* pStatus,
+  index_type threads,
+  index_type chunkSize = threads::DEFAULT_CHUNK_SIZE)
+{
+  using parser::ParallelParser;
+  index_type useful = ParallelParser::usefulThreads(n, threads, chunkSize);
+  if (useful == 1)
+    return parser::Parser(code, n).parse(pStatus);
+
+  ParallelParser parser(code, n, useful, chunkSize);
+  return parser.parse(pStatus);
+}
+
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_PARSE_PARALLEL_PARSER_H */
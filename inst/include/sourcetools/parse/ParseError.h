@@ -1,51 +1,136 @@
 #ifndef SOURCETOOLS_PARSE_PARSE_ERROR_H
 #define SOURCETOOLS_PARSE_PARSE_ERROR_H
 
+#include <string>
+
 #include <sourcetools/collection/collection.h>
 #include <sourcetools/tokenization/tokenization.h>
 
 namespace sourcetools {
 namespace parser {
 
+enum ParseErrorCode
+{
+  // "unexpected end of input"
+  PARSE_ERROR_UNEXPECTED_END,
+
+  // "unexpected token '<token>'", followed by "; expected type '<type>'"
+  // when a particular type of token was expected.
+  PARSE_ERROR_UNEXPECTED_TOKEN,
+
+  // A function formal followed by an operator other than '='.
+  PARSE_ERROR_EXPECTED_FORMAL_DEFAULT,
+
+  // A function formal not followed by ',' or ')'.
+  PARSE_ERROR_EXPECTED_FORMAL_SEPARATOR,
+
+  // A call argument not followed by ',' or the closing bracket (the
+  // expected type).
+  PARSE_ERROR_EXPECTED_ARGUMENT_SEPARATOR,
+
+  // A control-flow keyword was expected.
+  PARSE_ERROR_EXPECTED_CONTROL_FLOW_KEYWORD
+};
+
+// An error found while parsing: what went wrong, the token it went wrong
+// at, and (for some errors) the type of token expected there. Errors are
+// recorded as they are found, but their messages are only put together
+// when asked for; as with parse nodes, the token refers to the parsed
+// code, which must still be around by then.
 class ParseError
 {
   typedef collections::Position Position;
+  typedef collections::LineIndex LineIndex;
+  typedef collections::ColumnUnit ColumnUnit;
   typedef tokens::Token Token;
+  typedef tokens::TokenType TokenType;
 
-  Position start_;
-  Position end_;
-  std::string message_;
+  Token token_;
+  TokenType expected_;
+  ParseErrorCode code_;
 
 public:
 
-  ParseError(const tokens::Token& token,
-             const std::string& message)
-    : start_(token.position()),
-      end_(token.position()),
-      message_(message)
+  ParseError(ParseErrorCode code,
+             const Token& token,
+             TokenType expected = tokens::INVALID)
+    : token_(token),
+      expected_(expected),
+      code_(code)
   {
-    end_.column += token.end() - token.begin();
   }
 
-  ParseError(const Position& start,
-             const Position& end,
-             const std::string& message)
-    : start_(start),
-      end_(end),
-      message_(message)
+  ParseErrorCode code() const { return code_; }
+  const Token& token() const { return token_; }
+  TokenType expected() const { return expected_; }
+
+  Position start() const
   {
+    return token_.position();
   }
 
-  explicit ParseError(const std::string& message)
-    : start_(0, 0),
-      end_(0, 0),
-      message_(message)
+  Position end() const
   {
+    Position end = token_.position();
+    end.column += token_.size();
+    return end;
   }
 
-  const Position& start() const { return start_; }
-  const Position& end() const { return end_; }
-  const std::string& message() const { return message_; }
+  // As above, resolved through a line index (for errors at tokens produced
+  // without positions), with columns counted in 'unit'.
+  Position start(const LineIndex& index,
+                 ColumnUnit unit = collections::COLUMN_BYTES) const
+  {
+    if (token_.offset() == -1)
+      return start();
+    return index.position(token_.offset(), unit);
+  }
+
+  Position end(const LineIndex& index,
+               ColumnUnit unit = collections::COLUMN_BYTES) const
+  {
+    if (token_.offset() == -1)
+      return end();
+    return index.position(token_.offset() + token_.size(), unit);
+  }
+
+  std::string message() const
+  {
+    switch (code_)
+    {
+    case PARSE_ERROR_UNEXPECTED_END:
+      return "unexpected end of input";
+
+    case PARSE_ERROR_UNEXPECTED_TOKEN:
+    {
+      std::string message = "unexpected token '" + token_.contents() + "'";
+      if (expected_ != tokens::INVALID)
+        message += "; expected type '" + toString(expected_) + "'";
+      return message;
+    }
+
+    case PARSE_ERROR_EXPECTED_FORMAL_DEFAULT:
+      return "expected '=', ',' or ')' following argument name";
+
+    case PARSE_ERROR_EXPECTED_FORMAL_SEPARATOR:
+      return "expected ',' or ')'";
+
+    case PARSE_ERROR_EXPECTED_ARGUMENT_SEPARATOR:
+      return "expected ',' or '" + toString(expected_) + "'";
+
+    case PARSE_ERROR_EXPECTED_CONTROL_FLOW_KEYWORD:
+      return "expected control-flow keyword";
+    }
+
+    return "unknown error";
+  }
+
+  // Apply 'f' to the error's token (e.g. to move it into edited code).
+  template <typename F>
+  void transform(const F& f)
+  {
+    f(&token_);
+  }
 };
 
 } // namespace parser
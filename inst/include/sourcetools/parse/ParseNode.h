@@ -1,62 +1,58 @@
 #ifndef SOURCETOOLS_PARSE_PARSE_NODE_H
 #define SOURCETOOLS_PARSE_PARSE_NODE_H
 
-#include <map>
-#include <memory>
+#include <algorithm>
+#include <new>
+#include <vector>
 
 #include <sourcetools/collection/collection.h>
+#include <sourcetools/collection/Arena.h>
 #include <sourcetools/tokenization/tokenization.h>
 
 namespace sourcetools {
 namespace parser {
 
+// A node in the parse tree. Nodes, and their lists of children, are
+// allocated from an arena (see 'ParseStatus::arena()'), and so live until
+// the arena is destroyed; they must not be deleted individually.
 class ParseNode
 {
 public:
   typedef collections::Position Position;
   typedef collections::Range Range;
+  typedef collections::Arena Arena;
   typedef tokens::Token Token;
   typedef tokens::TokenType TokenType;
+  typedef std::vector<ParseNode*, collections::ArenaAllocator<ParseNode*> > Children;
 
 private:
   Token token_;
   ParseNode* parent_;
-  std::vector<ParseNode*> children_;
+  Children children_;
 
   Token begin_;
   Token end_;
 
-public:
-
-  explicit ParseNode(const Token& token)
+  ParseNode(Arena* pArena, const Token& token)
     : token_(token), parent_(NULL),
+      children_(collections::ArenaAllocator<ParseNode*>(pArena)),
       begin_(token), end_(token)
   {
   }
 
-  static ParseNode* create(const Token& token)
-  {
-    return new ParseNode(token);
-  }
+  // Nodes are freed along with their arena.
+  static void operator delete(void*);
 
-  static ParseNode* create(const TokenType& type)
-  {
-    static std::map<TokenType, Token> tokens;
-    if (!tokens.count(type))
-      tokens[type] = Token(type);
+public:
 
-    const Token& token = tokens[type];
-    return new ParseNode(token);
+  static ParseNode* create(Arena* pArena, const Token& token)
+  {
+    return new (pArena->allocate(sizeof(ParseNode))) ParseNode(pArena, token);
   }
 
-  ~ParseNode()
+  static ParseNode* create(Arena* pArena, const TokenType& type)
   {
-    for (std::vector<ParseNode*>::const_iterator it = children_.begin();
-         it != children_.end();
-         ++it)
-    {
-      delete *it;
-    }
+    return create(pArena, Token(type));
   }
 
   void remove(const ParseNode* pNode)
@@ -66,26 +62,66 @@ public:
       children_.end());
   }
 
+  // Spans are computed bottom-up: adding a child widens this node's span
+  // to cover the child's, but not the spans of this node's ancestors. The
+  // parser only ever adds nodes whose subtrees are complete, and attaches
+  // a node to its parent only once it is complete itself, so building a
+  // tree takes time linear in its size, however deep it is.
   void add(ParseNode* pNode)
   {
     if (pNode->parent_ != NULL)
       pNode->parent_->remove(pNode);
     pNode->parent_ = this;
 
-    const Token& begin = pNode->begin();
-    const Token& end   = pNode->end();
-    if (begin.offset() != -1 && end.offset() != -1)
+    widen(pNode);
+    children_.push_back(pNode);
+  }
+
+  // Replace the children [first, last) with 'nodes', which should not
+  // have a parent yet. This node's span is left as it was; see
+  // 'updateSpan()'.
+  void replace(index_type first,
+               index_type last,
+               const std::vector<ParseNode*>& nodes)
+  {
+    children_.erase(children_.begin() + first, children_.begin() + last);
+    children_.insert(children_.begin() + first, nodes.begin(), nodes.end());
+
+    for (index_type i = 0; i < utils::size(nodes); ++i)
+      nodes[i]->parent_ = this;
+  }
+
+  // Recompute this node's span from its children's.
+  void updateSpan()
+  {
+    begin_ = end_ = token_;
+    for (index_type i = 0; i < utils::size(children_); ++i)
+      widen(children_[i]);
+  }
+
+  // Apply 'f' to each of this node's tokens, e.g. to move them after the
+  // text around them has been edited.
+  template <typename F>
+  void transform(const F& f)
+  {
+    f(&token_);
+    f(&begin_);
+    f(&end_);
+  }
+
+  // Apply 'f' to the tokens of this node and all of its descendants.
+  template <typename F>
+  void transformTree(const F& f)
+  {
+    std::vector<ParseNode*> stack(1, this);
+    while (!stack.empty())
     {
-      for (ParseNode* pParent = this; pParent != NULL; pParent = pParent->parent_)
-      {
-        if (begin.begin() < pParent->begin().begin())
-          pParent->setBegin(begin);
-        if (end.end() > pParent->end().end())
-          pParent->setEnd(end);
-      }
-    }
+      ParseNode* pNode = stack.back();
+      stack.pop_back();
 
-    children_.push_back(pNode);
+      pNode->transform(f);
+      stack.insert(stack.end(), pNode->children_.begin(), pNode->children_.end());
+    }
   }
 
   const Token& begin() const
@@ -95,9 +131,8 @@ public:
 
   void setBegin(const Token& begin)
   {
-    for (ParseNode* pNode = this; pNode != NULL; pNode = pNode->parent_)
-      if (begin.begin() < pNode->begin().begin())
-        pNode->begin_ = begin;
+    if (begin.begin() < begin_.begin())
+      begin_ = begin;
   }
 
   const Token& end() const
@@ -108,9 +143,6 @@ public:
   void setEnd(const Token& end)
   {
     end_ = end;
-    for (ParseNode* pNode = this; pNode != NULL; pNode = pNode->parent_)
-      if (end.end() > pNode->end().end())
-        pNode->end_ = end;
   }
 
   void bounds(const char** begin, const char** end)
@@ -124,9 +156,30 @@ public:
     return Range(begin_.position(), end_.position() + end_.size());
   }
 
+  Range range(const collections::LineIndex& index) const
+  {
+    return Range(begin_.position(index), end_.position(index) + end_.size());
+  }
+
   const Token& token() const { return token_; }
+  collections::SymbolId symbol() const { return token_.symbol(); }
   const ParseNode* parent() const { return parent_; }
-  const std::vector<ParseNode*>& children() const { return children_; }
+  const Children& children() const { return children_; }
+
+private:
+
+  void widen(const ParseNode* pNode)
+  {
+    const Token& begin = pNode->begin();
+    const Token& end   = pNode->end();
+    if (begin.offset() != -1 && end.offset() != -1)
+    {
+      if (begin.begin() < begin_.begin())
+        begin_ = begin;
+      if (end.end() > end_.end())
+        end_ = end;
+    }
+  }
 };
 
 } // namespace parser
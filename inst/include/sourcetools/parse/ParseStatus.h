@@ -1,31 +1,136 @@
 #ifndef SOURCETOOLS_PARSE_PARSE_STATUS_H
 #define SOURCETOOLS_PARSE_PARSE_STATUS_H
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <sourcetools/core/core.h>
 #include <sourcetools/collection/Position.h>
+#include <sourcetools/collection/Arena.h>
+#include <sourcetools/collection/LineIndex.h>
 
 #include <sourcetools/parse/ParseError.h>
+#include <sourcetools/parse/ParseNode.h>
+#include <sourcetools/parse/FlatTree.h>
 
 namespace sourcetools {
 namespace parser {
 
-class ParseNode;
+class IncrementalParser;
+
+// Where a top-level expression starts (the offset and position of its
+// first token, or of the semicolons before it), and how many errors had
+// been found before it was parsed. 'resumable' records whether the
+// tokenizer had no '[' / '[[' brackets open there, so that parsing can be
+// restarted from it (see 'IncrementalParser').
+//
+// After a re-parse, 'shift' and 'rows' record how far the expression has
+// moved since its nodes were last updated, and 'stale' whether the text
+// has moved since (see 'ParseStatus::expression()').
+struct ExpressionStart
+{
+  ExpressionStart(index_type offset, index_type errors)
+    : offset(offset),
+      errors(errors),
+      resumable(false),
+      shift(0),
+      rows(0),
+      stale(false)
+  {
+  }
+
+  index_type offset;
+  index_type errors;
+  collections::Position position;
+  bool resumable;
+
+  index_type shift;
+  index_type rows;
+  bool stale;
+};
 
-class ParseStatus
+// Records the errors found while parsing, and owns the memory for the
+// parse tree: the tree is freed, in one go, along with the status.
+class ParseStatus : noncopyable
 {
   typedef collections::Position Position;
+  typedef collections::Arena Arena;
+  typedef collections::LineIndex LineIndex;
 
 public:
-  ParseStatus() {}
+  ParseStatus()
+    : pRoot_(NULL),
+      code_(NULL),
+      n_(0),
+      indexed_(false),
+      settled_(true)
+  {
+  }
+
+  Arena* arena()
+  {
+    return &arena_;
+  }
+
+  ParseNode* root()
+  {
+    settle();
+    return pRoot_;
+  }
+
+  // The i'th top-level expression (the i'th child of the root). After a
+  // re-parse, the expressions following the edit are only moved into place
+  // as they're asked for, either here or (all at once) by 'root()'.
+  ParseNode* expression(index_type i)
+  {
+    settle(i);
+    return pRoot_->children()[i];
+  }
 
-  void recordNodeLocation(const Position& position,
-                          ParseNode* pNode)
+  // Set the root of the tree parsed from 'code'.
+  void setRoot(ParseNode* pRoot, const char* code, index_type n)
   {
-    map_[position] = pNode;
+    pRoot_ = pRoot;
+    code_ = code;
+    n_ = n;
+    indexed_ = false;
   }
 
+  // Returns the node for the token at 'position', or NULL if there isn't
+  // one. Nothing is recorded while parsing: the first lookup flattens the
+  // tree (see 'FlatTree') and sorts its nodes by offset; later lookups
+  // resolve the position to an offset, and binary search for it.
   ParseNode* getNodeAtPosition(const Position& position)
   {
-    return map_[position];
+    if (!indexed_)
+      index();
+
+    // Positions past the end of their row have no token.
+    if (position.row < 0 || position.row >= lines_.rows() || position.column < 0)
+      return NULL;
+
+    index_type offset = lines_.offset(position);
+    index_type end = position.row + 1 < lines_.rows() ?
+      lines_.start(position.row + 1) :
+      n_;
+    if (offset >= end)
+      return NULL;
+
+    index_type lo = 0, hi = utils::size(locations_);
+    while (lo < hi)
+    {
+      index_type mid = lo + (hi - lo) / 2;
+      if (tree_[locations_[mid]].offset < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    if (lo == utils::size(locations_) || tree_[locations_[lo]].offset != offset)
+      return NULL;
+
+    return nodes_[locations_[lo]];
   }
 
   void addError(const ParseError& error)
@@ -38,9 +143,145 @@ public:
     return errors_;
   }
 
+  // One entry per child of the root, recorded so that the tree can later
+  // be partially re-parsed (see 'IncrementalParser').
+  void addExpressionStart(const ExpressionStart& start)
+  {
+    starts_.push_back(start);
+  }
+
+  const std::vector<ExpressionStart>& getExpressionStarts() const
+  {
+    return starts_;
+  }
+
 private:
-  std::map<Position, ParseNode*> map_;
+
+  friend class IncrementalParser;
+
+  // Moves a token by a number of bytes and rows.
+  class Shift
+  {
+  public:
+    Shift(const char* code, index_type bytes, index_type rows)
+      : code_(code), bytes_(bytes), rows_(rows)
+    {
+    }
+
+    void operator()(tokens::Token* pToken) const
+    {
+      // Tokens synthesized by the parser don't refer to the text.
+      if (pToken->offset() == -1)
+        return;
+
+      Position position = pToken->position();
+      if (position.row != -1)
+        position.row += rows_;
+
+      pToken->move(code_, pToken->offset() + bytes_, position);
+    }
+
+  private:
+    const char* code_;
+    index_type bytes_;
+    index_type rows_;
+  };
+
+  void settle(index_type i)
+  {
+    ExpressionStart& start = starts_[i];
+    if (start.shift == 0 && start.rows == 0 && !start.stale)
+      return;
+
+    pRoot_->children()[i]->transformTree(Shift(code_, start.shift, start.rows));
+    start.shift = start.rows = 0;
+    start.stale = false;
+  }
+
+  void settle()
+  {
+    if (settled_)
+      return;
+
+    for (index_type i = 0; i < utils::size(starts_); ++i)
+      settle(i);
+
+    pRoot_->updateSpan();
+    settled_ = true;
+  }
+
+  // Orders a flat tree's nodes by the offsets of their tokens.
+  class CompareOffsets
+  {
+  public:
+    explicit CompareOffsets(const FlatTree& tree)
+      : pTree_(&tree)
+    {
+    }
+
+    bool operator()(index_type lhs, index_type rhs) const
+    {
+      return (*pTree_)[lhs].offset < (*pTree_)[rhs].offset;
+    }
+
+  private:
+    const FlatTree* pTree_;
+  };
+
+  void index()
+  {
+    settle();
+    indexed_ = true;
+    tree_ = FlatTree();
+    nodes_.clear();
+    locations_.clear();
+    lines_ = LineIndex(code_, n_);
+    if (pRoot_ == NULL)
+      return;
+
+    // The flat tree holds its nodes in pre-order; record the parse nodes
+    // they came from in the same order.
+    tree_ = FlatTree(code_, pRoot_);
+    nodes_.reserve(tree_.size());
+    std::vector<ParseNode*> stack(1, pRoot_);
+    while (!stack.empty())
+    {
+      ParseNode* pNode = stack.back();
+      stack.pop_back();
+      nodes_.push_back(pNode);
+
+      const ParseNode::Children& children = pNode->children();
+      for (index_type i = utils::size(children) - 1; i >= 0; --i)
+        stack.push_back(children[i]);
+    }
+
+    // Nodes for synthesized tokens (e.g. ROOT, EMPTY) have no offset.
+    for (index_type i = 0; i < tree_.size(); ++i)
+      if (tree_[i].offset != -1)
+        locations_.push_back(i);
+
+    std::stable_sort(locations_.begin(), locations_.end(), CompareOffsets(tree_));
+  }
+
+  ParseNode* pRoot_;
+  const char* code_;
+  index_type n_;
   std::vector<ParseError> errors_;
+  std::vector<ExpressionStart> starts_;
+  Arena arena_;
+
+  // The index for position lookups: the flattened tree, the parse node
+  // for each of its nodes, its nodes with tokens (sorted by offset), and
+  // where the text's lines start.
+  bool indexed_;
+  FlatTree tree_;
+  std::vector<ParseNode*> nodes_;
+  std::vector<index_type> locations_;
+  LineIndex lines_;
+
+  // Whether every expression has been moved into place since the last
+  // re-parse (see 'IncrementalParser').
+  bool settled_;
 };
 } // namespace parser
 } // namespace sourcetools
@@ -3,6 +3,7 @@
 #define SOURCE_TOOLS_PARSE_PARSER_H
 
 #include <iostream>
+#include <vector>
 
 #include <sourcetools/tokenization/tokenization.h>
 #include <sourcetools/collection/collection.h>
@@ -16,7 +17,6 @@
 // Defines that will go away once the parser is more tested / game ready
 // #define SOURCE_TOOLS_DEBUG_PARSER_TRACE
 // #define SOURCE_TOOLS_DEBUG_PARSER_PRINT_TOKEN_INFO
-// #define SOURCE_TOOLS_DEBUG_PARSER_STACK_OVERFLOW
 
 #ifdef SOURCE_TOOLS_DEBUG_PARSER_TRACE
 # define SOURCE_TOOLS_DEBUG_PARSER_LOG(__X__) std::cerr << __X__ << std::endl
@@ -46,7 +46,7 @@ namespace parser {
 
 class Parser
 {
-  typedef tokenizer::Tokenizer Tokenizer;
+  typedef tokenizer::BufferedTokenizer<tokenizer::SignificantTokenizer> Tokenizer;
   typedef tokens::Token Token;
   typedef tokens::TokenType TokenType;
   typedef collections::Position Position;
@@ -58,74 +58,217 @@ class Parser
     PARSE_STATE_PAREN
   };
 
+  // The constructs parsed by routines with a frame of their own (see
+  // 'Parser sub-routines' below), and the stages they resume at.
+  enum Routine
+  {
+    ROUTINE_EXPRESSION,
+    ROUTINE_FUNCTION_CALL,
+    ROUTINE_FUNCTION_DEFINITION,
+    ROUTINE_FOR,
+    ROUTINE_IF,
+    ROUTINE_WHILE,
+    ROUTINE_REPEAT,
+    ROUTINE_BRACED_EXPRESSION,
+    ROUTINE_PARENTHETICAL_EXPRESSION,
+    ROUTINE_UNARY_OPERATOR
+  };
+
+  enum Stage
+  {
+    STAGE_BEGIN,
+
+    STAGE_EXPRESSION_OPERAND,
+    STAGE_EXPRESSION_RHS,
+    STAGE_EXPRESSION_CONTINUE,
+
+    STAGE_CALL_ARGUMENT_NEXT,
+    STAGE_CALL_ARGUMENT,
+    STAGE_CALL_NAMED_ARGUMENT,
+    STAGE_CALL_END,
+
+    STAGE_FUNCTION_FORMAL_NEXT,
+    STAGE_FUNCTION_FORMAL,
+    STAGE_FUNCTION_FORMALS_END,
+    STAGE_FUNCTION_BODY,
+
+    STAGE_FOR_SEQUENCE,
+    STAGE_FOR_BODY,
+
+    STAGE_IF_CONDITION,
+    STAGE_IF_BODY,
+    STAGE_IF_ELSE,
+
+    STAGE_WHILE_CONDITION,
+    STAGE_WHILE_BODY,
+
+    STAGE_REPEAT_BODY,
+
+    STAGE_BRACE_NEXT,
+    STAGE_BRACE_EXPRESSION,
+    STAGE_BRACE_END,
+
+    STAGE_PAREN_EXPRESSION,
+    STAGE_PAREN_END,
+
+    STAGE_UNARY_OPERAND
+  };
+
+  // A construct being parsed. A frame takes 40 bytes, and there is one
+  // per level of nesting, so a parse needs (and keeps, for reuse) 40
+  // bytes of stack for each level of its most deeply nested expression.
+  struct Frame
+  {
+    Routine routine;
+    Stage stage;
+
+    // The node being built, and an auxiliary node (function formals, or
+    // a named argument) being built within it.
+    ParseNode* pNode;
+    ParseNode* pAux;
+
+    // The parse state to restore when leaving a parenthesized or braced
+    // region; the precedence an expression must bind more tightly than;
+    // and the token closing a function call.
+    ParseState state;
+    int precedence;
+    TokenType rhsType;
+  };
+
   Tokenizer tokenizer_;
+  const char* code_;
+  index_type n_;
   Token token_;
   Token previous_;
   ParseState state_;
   ParseStatus* pStatus_;
 
+  std::vector<Frame> stack_;
+  ParseNode* pResult_;
+
+  index_type errorLimit_;
+  index_type firstError_;
+  bool stopped_;
+
 public:
-  explicit Parser(const std::string& code)
+
+  // When 'pSymbols' is given, symbol names are interned into it as they
+  // are tokenized, and the resulting nodes carry their ids. Parsers share
+  // no state otherwise, so they can run on many threads at once as long
+  // as each has a symbol table (and status) of its own.
+  explicit Parser(const std::string& code,
+                  collections::SymbolTable* pSymbols = NULL)
     : tokenizer_(code.c_str(), code.size()),
-      state_(PARSE_STATE_TOP_LEVEL)
+      code_(code.c_str()),
+      n_(code.size()),
+      state_(PARSE_STATE_TOP_LEVEL),
+      pStatus_(NULL),
+      pResult_(NULL),
+      errorLimit_(-1),
+      firstError_(0),
+      stopped_(false)
   {
+    tokenizer_.setSymbolTable(pSymbols);
     advance();
   }
 
-  explicit Parser(const char* code, index_type n)
+  explicit Parser(const char* code,
+                  index_type n,
+                  collections::SymbolTable* pSymbols = NULL)
     : tokenizer_(code, n),
-      state_(PARSE_STATE_TOP_LEVEL)
+      code_(code),
+      n_(n),
+      state_(PARSE_STATE_TOP_LEVEL),
+      pStatus_(NULL),
+      pResult_(NULL),
+      errorLimit_(-1),
+      firstError_(0),
+      stopped_(false)
   {
+    tokenizer_.setSymbolTable(pSymbols);
     advance();
   }
 
-private:
-
-  // Error-related ----
-
-  void unexpectedEndOfInput()
+  // Start parsing at 'offset', which should be the start of a top-level
+  // expression, with the tokenizer state there (see 'BasicTokenizer').
+  Parser(const char* code,
+         index_type n,
+         index_type offset,
+         const Position& position,
+         const std::vector<TokenType>& stack,
+         collections::SymbolTable* pSymbols = NULL)
+    : tokenizer_(code, n, offset, position, stack),
+      code_(code),
+      n_(n),
+      state_(PARSE_STATE_TOP_LEVEL),
+      pStatus_(NULL),
+      pResult_(NULL),
+      errorLimit_(-1),
+      firstError_(0),
+      stopped_(false)
   {
-    ParseError error("unexpected end of input");
-    pStatus_->addError(error);
+    tokenizer_.setSymbolTable(pSymbols);
+    advance();
   }
 
-  std::string unexpectedTokenString(const Token& token)
+  // Stop parsing once 'limit' errors have been found: the rest of the
+  // document is treated as missing. By default (or for a limit below 1),
+  // there's no limit.
+  void setErrorLimit(index_type limit)
   {
-    return std::string() +
-      "unexpected token '" + token.contents() + "'";
+    errorLimit_ = limit;
   }
 
-  std::string unexpectedTokenString(const Token& token,
-                                    TokenType expectedType)
-  {
-    return unexpectedTokenString(token) +
-      "; expected type '" + toString(expectedType) + "'";
-  }
+private:
 
-  void unexpectedToken(const Token& token)
+  // Error-related ----
+  //
+  // Errors are recorded as a code and the token they're about; messages
+  // are only formatted if someone asks for them. While recovering from
+  // broken code, the parser can run into the same token again and again
+  // (e.g. the end of the document, once for each construct left open);
+  // within a top-level expression, only the first error at a token is
+  // recorded.
+
+  void addError(ParseErrorCode code,
+                const Token& token,
+                TokenType expected = tokens::INVALID)
   {
-    unexpectedToken(token, unexpectedTokenString(token));
-  }
+    if (stopped_)
+      return;
 
-  void unexpectedToken(const Token& token,
-                       TokenType type)
-  {
-    unexpectedToken(token, unexpectedTokenString(token, type));
+    const std::vector<ParseError>& errors = pStatus_->getErrors();
+    index_type count = utils::size(errors);
+    for (index_type i = count - 1; i >= firstError_; --i)
+    {
+      const Token& previous = errors[i].token();
+      if (previous.offset() == token.offset() && previous.type() == token.type())
+        return;
+
+      // Errors are found in order, so there's nothing more to compare.
+      if (previous.offset() < token.offset())
+        break;
+    }
+
+    pStatus_->addError(ParseError(code, token, expected));
+
+    // Once we've found as many errors as we were asked to, pretend the
+    // document ends here, so that we stop parsing as soon as possible.
+    if (errorLimit_ > 0 && count + 1 >= errorLimit_)
+      stopped_ = true;
   }
 
   void unexpectedToken(const Token& token,
-                       const std::string& message)
+                       TokenType expected = tokens::INVALID)
   {
-    ParseError error(token, message);
-    pStatus_->addError(error);
+    addError(PARSE_ERROR_UNEXPECTED_TOKEN, token, expected);
   }
 
   bool checkUnexpectedEnd(const Token& token)
   {
     if (UNLIKELY(token.isType(tokens::END)))
     {
-      ParseError error(token, "unexpected end of input");
-      pStatus_->addError(error);
+      addError(PARSE_ERROR_UNEXPECTED_END, token);
       return true;
     }
 
@@ -133,220 +276,386 @@ private:
   }
 
   // Parser sub-routines ----
+  //
+  // Nested code nests the parser's work, but rather than recursing on the
+  // C stack (which generated code can easily overflow), the parser keeps
+  // a stack of frames on the heap, one per construct being parsed. Each
+  // construct's routine is run in stages: to parse a sub-expression, it
+  // records the stage to resume at and enters a new frame (or, for e.g.
+  // a missing expression, leaves a node in 'pResult_' directly). When the
+  // sub-expression's frame leaves, its node is left in 'pResult_' and the
+  // routine is resumed.
+  //
+  // Binary operators are parsed in a loop within a single frame, so only
+  // nesting (of calls, parentheses, braces, right-associative operators)
+  // grows the stack.
 
-  ParseNode* parseFunctionArgumentListOne()
+  void parseFunctionDefinition(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFunctionArgument()");
     using namespace tokens;
 
-    check(SYMBOL);
-
-    Token lookahead = peek(1);
-    if (lookahead.isType(COMMA) || lookahead.isType(RPAREN))
-      return ParseNode::create(consume());
-    else if (lookahead.isType(OPERATOR_ASSIGN_LEFT_EQUALS))
-      return parseExpression();
-
-    if (isOperator(lookahead))
-      unexpectedToken(lookahead, "expected '=', ',' or ')' following argument name");
+    switch (frame.stage)
+    {
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFunctionDefinition()");
+      frame.pNode = createNode(current());
+      checkAndAdvance(KEYWORD_FUNCTION);
+      checkAndAdvance(LPAREN, false);
+      frame.state = state_;
+      state_ = PARSE_STATE_PAREN;
+      frame.pAux = createNode(EMPTY);
+      frame.stage = token_.isType(RPAREN) ?
+        STAGE_FUNCTION_FORMALS_END :
+        STAGE_FUNCTION_FORMAL_NEXT;
+      return;
+
+    case STAGE_FUNCTION_FORMAL_NEXT:
+    {
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFunctionArgument()");
+      if (checkUnexpectedEnd(current()))
+      {
+        frame.stage = STAGE_FUNCTION_FORMALS_END;
+        return;
+      }
 
-    return parseExpression();
-  }
+      check(SYMBOL);
+      frame.stage = STAGE_FUNCTION_FORMAL;
 
-  ParseNode* parseFunctionArgumentList()
-  {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFunctionArgumentList()");
-    using namespace tokens;
+      Token lookahead = peek(1);
+      if (lookahead.isType(COMMA) || lookahead.isType(RPAREN))
+      {
+        pResult_ = createNode(consume());
+        return;
+      }
 
-    ParseNode* pNode = createNode(EMPTY);
-    if (token_.isType(RPAREN))
-      return pNode;
+      if (!lookahead.isType(OPERATOR_ASSIGN_LEFT_EQUALS) && isOperator(lookahead))
+        addError(PARSE_ERROR_EXPECTED_FORMAL_DEFAULT, lookahead);
 
-    while (true)
-    {
-      if (checkUnexpectedEnd(current()))
-        break;
+      parseNonEmptyExpression();
+      return;
+    }
 
-      pNode->add(parseFunctionArgumentListOne());
+    case STAGE_FUNCTION_FORMAL:
+      frame.pAux->add(pResult_);
       if (current().isType(RPAREN))
-        return pNode;
-      else if (current().isType(COMMA))
+      {
+        frame.stage = STAGE_FUNCTION_FORMALS_END;
+        return;
+      }
+
+      frame.stage = STAGE_FUNCTION_FORMAL_NEXT;
+      if (current().isType(COMMA))
       {
         advance();
-        continue;
+        return;
       }
 
       // TODO: how should we recover here? For now, we
       // assume that there should have been a comma and
       // continue parsing.
-      unexpectedToken(current(), "expected ',' or ')'");
-      continue;
+      addError(PARSE_ERROR_EXPECTED_FORMAL_SEPARATOR, current());
+      return;
+
+    case STAGE_FUNCTION_FORMALS_END:
+      frame.pNode->add(frame.pAux);
+      state_ = frame.state;
+      checkAndAdvance(RPAREN, false);
+      frame.stage = STAGE_FUNCTION_BODY;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_FUNCTION_BODY:
+      frame.pNode->add(pResult_);
+      leave(frame.pNode);
+      return;
+
+    default:
+      return;
     }
-
-    return pNode;
   }
 
-  ParseNode* parseFunctionDefinition()
+  void parseFor(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFunctionDefinition()");
     using namespace tokens;
-    ParseNode* pNode = createNode(current());
-    checkAndAdvance(KEYWORD_FUNCTION);
-    checkAndAdvance(LPAREN, false);
-    ParseState state = state_;
-    state_ = PARSE_STATE_PAREN;
-    pNode->add(parseFunctionArgumentList());
-    state_ = state;
-    checkAndAdvance(RPAREN, false);
-    pNode->add(parseNonEmptyExpression());
-    return pNode;
+
+    switch (frame.stage)
+    {
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFor()");
+      frame.pNode = createNode(current());
+      checkAndAdvance(KEYWORD_FOR);
+      checkAndAdvance(LPAREN, false);
+      frame.state = state_;
+      state_ = PARSE_STATE_PAREN;
+      check(SYMBOL);
+      frame.pNode->add(createNode(consume()));
+      checkAndAdvance(KEYWORD_IN, false);
+      frame.stage = STAGE_FOR_SEQUENCE;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_FOR_SEQUENCE:
+      frame.pNode->add(pResult_);
+      state_ = frame.state;
+      checkAndAdvance(RPAREN, false);
+      frame.stage = STAGE_FOR_BODY;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_FOR_BODY:
+      frame.pNode->add(pResult_);
+      leave(frame.pNode);
+      return;
+
+    default:
+      return;
+    }
   }
 
-  ParseNode* parseFor()
+  void parseIf(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFor()");
     using namespace tokens;
-    ParseNode* pNode = createNode(current());
-    checkAndAdvance(KEYWORD_FOR);
-    checkAndAdvance(LPAREN, false);
-    ParseState state = state_;
-    state_ = PARSE_STATE_PAREN;
-    check(SYMBOL);
-    pNode->add(createNode(consume()));
-    checkAndAdvance(KEYWORD_IN, false);
-    pNode->add(parseNonEmptyExpression());
-    state_ = state;
-    checkAndAdvance(RPAREN, false);
-    pNode->add(parseNonEmptyExpression());
-    return pNode;
-  }
-
-  ParseNode* parseIf()
-  {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseIf()");
-    using namespace tokens;
-    ParseNode* pNode = createNode(current());
-    checkAndAdvance(KEYWORD_IF);
-    checkAndAdvance(LPAREN, false);
-    ParseState state = state_;
-    state_ = PARSE_STATE_PAREN;
-    pNode->add(parseNonEmptyExpression());
-    state_ = state;
-    checkAndAdvance(RPAREN, false);
-    pNode->add(parseNonEmptyExpression());
-    if (current().isType(KEYWORD_ELSE))
+
+    switch (frame.stage)
     {
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseIf()");
+      frame.pNode = createNode(current());
+      checkAndAdvance(KEYWORD_IF);
+      checkAndAdvance(LPAREN, false);
+      frame.state = state_;
+      state_ = PARSE_STATE_PAREN;
+      frame.stage = STAGE_IF_CONDITION;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_IF_CONDITION:
+      frame.pNode->add(pResult_);
+      state_ = frame.state;
+      checkAndAdvance(RPAREN, false);
+      frame.stage = STAGE_IF_BODY;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_IF_BODY:
+      frame.pNode->add(pResult_);
+      if (!current().isType(KEYWORD_ELSE))
+      {
+        leave(frame.pNode);
+        return;
+      }
+
       advance();
-      pNode->add(parseNonEmptyExpression());
+      frame.stage = STAGE_IF_ELSE;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_IF_ELSE:
+      frame.pNode->add(pResult_);
+      leave(frame.pNode);
+      return;
+
+    default:
+      return;
     }
-    return pNode;
   }
 
-  ParseNode* parseWhile()
+  void parseWhile(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseWhile()");
     using namespace tokens;
-    ParseNode* pNode = createNode(current());
-    checkAndAdvance(KEYWORD_WHILE);
-    checkAndAdvance(LPAREN, false);
-    ParseState state = state_;
-    state_ = PARSE_STATE_PAREN;
-    pNode->add(parseNonEmptyExpression());
-    state_ = state;
-    checkAndAdvance(RPAREN, false);
-    pNode->add(parseNonEmptyExpression());
-    return pNode;
+
+    switch (frame.stage)
+    {
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseWhile()");
+      frame.pNode = createNode(current());
+      checkAndAdvance(KEYWORD_WHILE);
+      checkAndAdvance(LPAREN, false);
+      frame.state = state_;
+      state_ = PARSE_STATE_PAREN;
+      frame.stage = STAGE_WHILE_CONDITION;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_WHILE_CONDITION:
+      frame.pNode->add(pResult_);
+      state_ = frame.state;
+      checkAndAdvance(RPAREN, false);
+      frame.stage = STAGE_WHILE_BODY;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_WHILE_BODY:
+      frame.pNode->add(pResult_);
+      leave(frame.pNode);
+      return;
+
+    default:
+      return;
+    }
   }
 
-  ParseNode* parseRepeat()
+  void parseRepeat(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseRepeat()");
     using namespace tokens;
-    ParseNode* pNode = createNode(current());
-    checkAndAdvance(KEYWORD_REPEAT);
-    pNode->add(parseNonEmptyExpression());
-    return pNode;
+
+    switch (frame.stage)
+    {
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseRepeat()");
+      frame.pNode = createNode(current());
+      checkAndAdvance(KEYWORD_REPEAT);
+      frame.stage = STAGE_REPEAT_BODY;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_REPEAT_BODY:
+      frame.pNode->add(pResult_);
+      leave(frame.pNode);
+      return;
+
+    default:
+      return;
+    }
   }
 
-  ParseNode* parseControlFlowKeyword()
+  void parseControlFlowKeyword()
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseControlFlowKeyword('" << token_.contents() << "')");
+    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseControlFlowKeyword('" << current().contents() << "')");
     using namespace tokens;
 
     const Token& token = current();
     if (token.isType(KEYWORD_FUNCTION))
-      return parseFunctionDefinition();
+      enter(ROUTINE_FUNCTION_DEFINITION);
     else if (token.isType(KEYWORD_IF))
-      return parseIf();
+      enter(ROUTINE_IF);
     else if (token.isType(KEYWORD_WHILE))
-      return parseWhile();
+      enter(ROUTINE_WHILE);
     else if (token.isType(KEYWORD_FOR))
-      return parseFor();
+      enter(ROUTINE_FOR);
     else if (token.isType(KEYWORD_REPEAT))
-      return parseRepeat();
-
-    unexpectedToken(consume(), "expected control-flow keyword");
-    return createNode(INVALID);
+      enter(ROUTINE_REPEAT);
+    else
+    {
+      addError(PARSE_ERROR_EXPECTED_CONTROL_FLOW_KEYWORD, consume());
+      pResult_ = createNode(INVALID);
+    }
   }
 
-  ParseNode* parseBracedExpression()
+  void parseBracedExpression(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseBracedExpression()");
     using namespace tokens;
-    ParseNode* pNode = createNode(current());
 
-    checkAndAdvance(LBRACE);
-    ParseState state = state_;
-    state_ = PARSE_STATE_BRACE;
-    skipSemicolons();
-    if (current().isType(RBRACE))
-    {
-      pNode->add(createNode(EMPTY));
-    }
-    else
+    switch (frame.stage)
     {
-      while (!current().isType(RBRACE))
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseBracedExpression()");
+      frame.pNode = createNode(current());
+      checkAndAdvance(LBRACE);
+      frame.state = state_;
+      state_ = PARSE_STATE_BRACE;
+      skipSemicolons();
+      if (current().isType(RBRACE))
       {
-        if (checkUnexpectedEnd(current()))
-          break;
-        pNode->add(parseNonEmptyExpression());
-        skipSemicolons();
+        frame.pNode->add(createNode(EMPTY));
+        frame.stage = STAGE_BRACE_END;
+        return;
+      }
+
+      frame.stage = STAGE_BRACE_NEXT;
+      return;
+
+    case STAGE_BRACE_NEXT:
+      if (current().isType(RBRACE) || checkUnexpectedEnd(current()))
+      {
+        frame.stage = STAGE_BRACE_END;
+        return;
       }
-    }
-    state_ = state;
-    pNode->setEnd(current());
-    checkAndAdvance(RBRACE);
 
-    return pNode;
+      frame.stage = STAGE_BRACE_EXPRESSION;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_BRACE_EXPRESSION:
+      frame.pNode->add(pResult_);
+      skipSemicolons();
+      frame.stage = STAGE_BRACE_NEXT;
+      return;
+
+    case STAGE_BRACE_END:
+      state_ = frame.state;
+      frame.pNode->setEnd(current());
+      checkAndAdvance(RBRACE);
+      leave(frame.pNode);
+      return;
+
+    default:
+      return;
+    }
   }
 
-  ParseNode* parseParentheticalExpression()
+  void parseParentheticalExpression(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseParentheticalExpression()");
     using namespace tokens;
-    ParseNode* pNode = createNode(current());
-    checkAndAdvance(LPAREN);
-    ParseState state = state_;
-    state_ = PARSE_STATE_PAREN;
-    if (current().isType(RPAREN))
-      unexpectedToken(current());
-    else
-      pNode->add(parseNonEmptyExpression());
-    state_ = state;
-    pNode->setEnd(current());
-    checkAndAdvance(RPAREN);
-    return pNode;
+
+    switch (frame.stage)
+    {
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseParentheticalExpression()");
+      frame.pNode = createNode(current());
+      checkAndAdvance(LPAREN);
+      frame.state = state_;
+      state_ = PARSE_STATE_PAREN;
+      if (current().isType(RPAREN))
+      {
+        unexpectedToken(current());
+        frame.stage = STAGE_PAREN_END;
+        return;
+      }
+
+      frame.stage = STAGE_PAREN_EXPRESSION;
+      parseNonEmptyExpression();
+      return;
+
+    case STAGE_PAREN_EXPRESSION:
+      frame.pNode->add(pResult_);
+      frame.stage = STAGE_PAREN_END;
+      return;
+
+    case STAGE_PAREN_END:
+      state_ = frame.state;
+      frame.pNode->setEnd(current());
+      checkAndAdvance(RPAREN);
+      leave(frame.pNode);
+      return;
+
+    default:
+      return;
+    }
   }
 
-  ParseNode* parseUnaryOperator()
+  void parseUnaryOperator(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseUnaryOperator()");
-    ParseNode* pNode = createNode(current());
-    pNode->add(parseNonEmptyExpression(precedence::unary(consume())));
-    return pNode;
+    switch (frame.stage)
+    {
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseUnaryOperator()");
+      frame.pNode = createNode(current());
+      frame.stage = STAGE_UNARY_OPERAND;
+      parseNonEmptyExpression(precedence::unary(consume()));
+      return;
+
+    case STAGE_UNARY_OPERAND:
+      frame.pNode->add(pResult_);
+      leave(frame.pNode);
+      return;
+
+    default:
+      return;
+    }
   }
 
-  ParseNode* parseExpressionStart()
+  void parseExpressionStart()
   {
     SOURCE_TOOLS_DEBUG_PARSER_LOG("parseExpressionStart('" << current().contents() << "')");
     SOURCE_TOOLS_DEBUG_PARSER_LOG("Type: " << toString(current().type()));
@@ -356,45 +665,22 @@ private:
     const Token& token = current();
 
     if (isControlFlowKeyword(token))
-      return parseControlFlowKeyword();
+      parseControlFlowKeyword();
     else if (token.isType(LBRACE))
-      return parseBracedExpression();
+      enter(ROUTINE_BRACED_EXPRESSION);
     else if (token.isType(LPAREN))
-      return parseParentheticalExpression();
+      enter(ROUTINE_PARENTHETICAL_EXPRESSION);
     else if (isUnaryOperator(token))
-      return parseUnaryOperator();
+      enter(ROUTINE_UNARY_OPERATOR);
     else if (isSymbolic(token) || isKeyword(token))
-      return createNode(consume());
+      pResult_ = createNode(consume());
     else if (token.isType(END))
-      return NULL;
-
-    unexpectedToken(consume());
-    return createNode(INVALID);
-  }
-
-  ParseNode* parseFunctionCallOne(TokenType rhsType)
-  {
-    using namespace tokens;
-
-    const Token& token = current();
-    if (token.isType(COMMA) || token.isType(rhsType))
-      return createNode(Token(MISSING));
-
-    if (peek(1).isType(OPERATOR_ASSIGN_LEFT_EQUALS))
+      pResult_ = NULL;
+    else
     {
-      ParseNode* pLhs  = createNode(consume());
-      ParseNode* pNode = createNode(consume());
-      pNode->add(pLhs);
-
-      if (current().isType(COMMA) || current().isType(rhsType))
-        pNode->add(createNode(MISSING));
-      else
-        pNode->add(parseNonEmptyExpression());
-
-      return pNode;
+      unexpectedToken(consume());
+      pResult_ = createNode(INVALID);
     }
-
-    return parseNonEmptyExpression();
   }
 
   // Parse a function call, e.g.
@@ -407,85 +693,167 @@ private:
   //
   // Parsing a function call is surprisingly tricky, due to the
   // nature of allowing a mixture of unnamed, named, and missing
-  // arguments.
-  ParseNode* parseFunctionCall(ParseNode* pLhs)
+  // arguments. The frame is entered with the called expression as
+  // its node.
+  void parseFunctionCall(Frame& frame)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFunctionCall('" << current().contents() << "')");
     using namespace tokens;
-    TokenType lhsType = current().type();
-    TokenType rhsType = complement(lhsType);
 
-    ParseNode* pNode = createNode(current());
-    pNode->add(pLhs);
+    switch (frame.stage)
+    {
+    case STAGE_BEGIN:
+    {
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseFunctionCall('" << current().contents() << "')");
+      TokenType lhsType = current().type();
+      frame.rhsType = complement(lhsType);
 
-    checkAndAdvance(lhsType);
+      ParseNode* pNode = createNode(current());
+      pNode->add(frame.pNode);
+      frame.pNode = pNode;
 
-    ParseState state = state_;
-    state_ = PARSE_STATE_PAREN;
+      checkAndAdvance(lhsType);
 
-    if (current().isType(rhsType))
-    {
-      pNode->add(lhsType == LPAREN ?
-                   createNode(Token(EMPTY)) :
-                   createNode(Token(MISSING)));
+      frame.state = state_;
+      state_ = PARSE_STATE_PAREN;
+
+      if (current().isType(frame.rhsType))
+      {
+        pNode->add(lhsType == LPAREN ?
+                     createNode(Token(EMPTY)) :
+                     createNode(Token(MISSING)));
+        frame.stage = STAGE_CALL_END;
+        return;
+      }
+
+      frame.stage = STAGE_CALL_ARGUMENT_NEXT;
+      return;
     }
-    else
+
+    case STAGE_CALL_ARGUMENT_NEXT:
     {
-      while (true)
+      if (checkUnexpectedEnd(current()))
+      {
+        frame.stage = STAGE_CALL_END;
+        return;
+      }
+
+      frame.stage = STAGE_CALL_ARGUMENT;
+
+      const Token& token = current();
+      if (token.isType(COMMA) || token.isType(frame.rhsType))
       {
-        if (checkUnexpectedEnd(current()))
-          break;
+        pResult_ = createNode(Token(MISSING));
+        return;
+      }
 
-        pNode->add(parseFunctionCallOne(rhsType));
+      if (peek(1).isType(OPERATOR_ASSIGN_LEFT_EQUALS))
+      {
+        ParseNode* pLhs  = createNode(consume());
+        ParseNode* pNode = createNode(consume());
+        pNode->add(pLhs);
 
-        const Token& token = current();
-        if (token.isType(COMMA))
-        {
-          consume();
-          continue;
-        }
-        else if (token.isType(rhsType))
+        if (current().isType(COMMA) || current().isType(frame.rhsType))
         {
-          break;
+          pNode->add(createNode(MISSING));
+          pResult_ = pNode;
+          return;
         }
 
-        std::string message = std::string() +
-          "expected ',' or '" + toString(rhsType) + "'";
-        unexpectedToken(current(), message);
+        frame.pAux = pNode;
+        frame.stage = STAGE_CALL_NAMED_ARGUMENT;
       }
+
+      parseNonEmptyExpression();
+      return;
+    }
+
+    case STAGE_CALL_NAMED_ARGUMENT:
+      frame.pAux->add(pResult_);
+      pResult_ = frame.pAux;
+      frame.stage = STAGE_CALL_ARGUMENT;
+      return;
+
+    case STAGE_CALL_ARGUMENT:
+    {
+      frame.pNode->add(pResult_);
+
+      const Token& token = current();
+      if (token.isType(COMMA))
+      {
+        consume();
+        frame.stage = STAGE_CALL_ARGUMENT_NEXT;
+        return;
+      }
+      else if (token.isType(frame.rhsType))
+      {
+        frame.stage = STAGE_CALL_END;
+        return;
+      }
+
+      addError(PARSE_ERROR_EXPECTED_ARGUMENT_SEPARATOR, current(), frame.rhsType);
+      frame.stage = STAGE_CALL_ARGUMENT_NEXT;
+      return;
     }
 
-    checkAndAdvance(rhsType);
+    case STAGE_CALL_END:
+      checkAndAdvance(frame.rhsType);
+      state_ = frame.state;
+
+      // Chained calls, e.g. 'f(a)(b)[c]', call the call just parsed.
+      if (isCallOperator(current()) && canParseExpressionContinuation())
+      {
+        frame.stage = STAGE_BEGIN;
+        return;
+      }
 
-    state_ = state;
+      leave(frame.pNode);
+      return;
 
-    if (isCallOperator(current()) && canParseExpressionContinuation())
-      return parseFunctionCall(pNode);
-    return pNode;
+    default:
+      return;
+    }
   }
 
-  ParseNode* parseExpressionContinuation(ParseNode* pNode)
+  // Extend the expression parsed so far with any binary operators and
+  // calls that follow it, for as long as they bind more tightly than
+  // the frame's precedence.
+  void parseExpressionContinuation(Frame& frame)
   {
     using namespace tokens;
+
+    if (!canParseExpressionContinuation(frame.precedence))
+    {
+      leave(frame.pNode);
+      return;
+    }
+
     SOURCE_TOOLS_DEBUG_PARSER_LOG("parseExpressionContinuation('" << current().contents() << "')");
     SOURCE_TOOLS_DEBUG_PARSER_LOG("Type: " << toString(current().type()));
 
     Token token = current();
     if (isCallOperator(token))
-      return parseFunctionCall(pNode);
+    {
+      frame.stage = STAGE_EXPRESSION_OPERAND;
+      enter(ROUTINE_FUNCTION_CALL, 0, frame.pNode);
+      return;
+    }
     else if (token.isType(END))
-      return createNode(token);
+    {
+      frame.pNode = createNode(token);
+      return;
+    }
 
     ParseNode* pNew = createNode(token);
-    pNew->add(pNode);
+    pNew->add(frame.pNode);
+    frame.pNode = pNew;
 
     advance();
     int precedence =
       precedence::binary(token) -
       precedence::isRightAssociative(token);
-    pNew->add(parseNonEmptyExpression(precedence));
 
-    return pNew;
+    frame.stage = STAGE_EXPRESSION_RHS;
+    parseNonEmptyExpression(precedence);
   }
 
   bool canParseExpressionContinuation(int precedence = 0)
@@ -496,32 +864,131 @@ private:
     if (state_ == PARSE_STATE_PAREN)
       return true;
 
-    index_type lhs = previous().row();
-    index_type rhs = current().row();
-    if (previous().isType(tokens::STRING))
+    // Compare against the row the previous token ends on, which differs
+    // from the row it starts on for e.g. multi-line strings.
+    return previous().endRow() == current().row();
+  }
+
+  void parseExpression(Frame& frame)
+  {
+    switch (frame.stage)
+    {
+    case STAGE_BEGIN:
+      SOURCE_TOOLS_DEBUG_PARSER_LOG("parseExpression(" << frame.precedence << ")");
     {
-      lhs += std::count(previous().begin(), previous().end(), '\n');
+      frame.stage = STAGE_EXPRESSION_OPERAND;
+
+      // Most operands are single tokens, which leave their node without
+      // entering a frame; carry on with them directly.
+      std::size_t depth = stack_.size();
+      parseExpressionStart();
+      if (stack_.size() == depth)
+      {
+        frame.pNode = pResult_;
+        parseExpressionContinuation(frame);
+      }
+      return;
     }
 
-    return lhs == rhs;
+    case STAGE_EXPRESSION_OPERAND:
+      frame.pNode = pResult_;
+      parseExpressionContinuation(frame);
+      return;
+
+    case STAGE_EXPRESSION_RHS:
+      frame.pNode->add(pResult_);
+      parseExpressionContinuation(frame);
+      return;
+
+    case STAGE_EXPRESSION_CONTINUE:
+      parseExpressionContinuation(frame);
+      return;
 
+    default:
+      return;
+    }
   }
 
-  ParseNode* parseExpression(int precedence = 0)
+  void parseNonEmptyExpression(int precedence = 0)
   {
-    SOURCE_TOOLS_DEBUG_PARSER_LOG("parseExpression(" << precedence << ")");
     using namespace tokens;
-    ParseNode* pNode = parseExpressionStart();
-    while (canParseExpressionContinuation(precedence))
-      pNode = parseExpressionContinuation(pNode);
-    return pNode;
+
+    // Skip semicolons first, so that we don't run into the end of the
+    // document (e.g. in 'f(;') after checking for it.
+    skipSemicolons();
+
+    const Token& token = current();
+    if (checkUnexpectedEnd(token))
+    {
+      pResult_ = createNode(MISSING);
+      return;
+    }
+
+    // Operands are most often a single symbol, number or string that
+    // nothing binds to; these don't need a frame at all.
+    if (isSymbolic(token))
+    {
+      ParseNode* pNode = createNode(consume());
+      if (!canParseExpressionContinuation(precedence))
+      {
+        pResult_ = pNode;
+        return;
+      }
+
+      enter(ROUTINE_EXPRESSION, precedence, pNode);
+      stack_.back().stage = STAGE_EXPRESSION_CONTINUE;
+      return;
+    }
+
+    enter(ROUTINE_EXPRESSION, precedence);
+  }
+
+  // Frames ----
+
+  void enter(Routine routine, int precedence = 0, ParseNode* pNode = NULL)
+  {
+    Frame frame;
+    frame.routine = routine;
+    frame.stage = STAGE_BEGIN;
+    frame.pNode = pNode;
+    frame.pAux = NULL;
+    frame.state = state_;
+    frame.precedence = precedence;
+    frame.rhsType = tokens::INVALID;
+    stack_.push_back(frame);
   }
 
-  ParseNode* parseNonEmptyExpression(int precedence = 0)
+  void leave(ParseNode* pNode)
   {
-    if (checkUnexpectedEnd(current()))
-      return ParseNode::create(tokens::MISSING);
-    return parseExpression(precedence);
+    pResult_ = pNode;
+    stack_.pop_back();
+  }
+
+  void resume(Frame& frame)
+  {
+    switch (frame.routine)
+    {
+    case ROUTINE_EXPRESSION:               return parseExpression(frame);
+    case ROUTINE_FUNCTION_CALL:            return parseFunctionCall(frame);
+    case ROUTINE_FUNCTION_DEFINITION:      return parseFunctionDefinition(frame);
+    case ROUTINE_FOR:                      return parseFor(frame);
+    case ROUTINE_IF:                       return parseIf(frame);
+    case ROUTINE_WHILE:                    return parseWhile(frame);
+    case ROUTINE_REPEAT:                   return parseRepeat(frame);
+    case ROUTINE_BRACED_EXPRESSION:        return parseBracedExpression(frame);
+    case ROUTINE_PARENTHETICAL_EXPRESSION: return parseParentheticalExpression(frame);
+    case ROUTINE_UNARY_OPERATOR:           return parseUnaryOperator(frame);
+    }
+  }
+
+  // Parse one top-level expression, returning NULL at the end of input.
+  ParseNode* parseTopLevelExpression()
+  {
+    firstError_ = utils::size(pStatus_->getErrors());
+    enter(ROUTINE_EXPRESSION);
+    while (!stack_.empty())
+      resume(stack_.back());
+    return pResult_;
   }
 
   // Tokenization ----
@@ -539,12 +1006,13 @@ private:
   bool advance()
   {
     previous_ = token_;
-    using namespace tokens;
+    if (UNLIKELY(stopped_))
+    {
+      token_ = Token(tokens::END);
+      return false;
+    }
 
-    bool success = tokenizer_.tokenize(&token_);
-    while (success && (isComment(token_) || isWhitespace(token_)))
-      success = tokenizer_.tokenize(&token_);
-    return success;
+    return tokenizer_.tokenize(&token_);
   }
 
   bool check(TokenType type)
@@ -563,42 +1031,21 @@ private:
     return result;
   }
 
-  Token peek(index_type lookahead = 0,
-             bool skipWhitespace = true,
-             bool skipComments = true)
+  Token peek(index_type lookahead = 0)
   {
-    index_type offset = lookahead;
-
-    while (true)
-    {
-      Token result = tokenizer_.peek(offset);
-      if ((skipWhitespace && result.isType(tokens::WHITESPACE)) ||
-          (skipComments && result.isType(tokens::COMMENT)))
-      {
-        ++offset;
-        continue;
-      }
-
-      if (lookahead == 0)
-        return result;
-
-      --lookahead;
-    }
-
+    return tokenizer_.peek(lookahead);
   }
 
   // Utils ----
 
   ParseNode* createNode(TokenType type)
   {
-    return ParseNode::create(type);
+    return ParseNode::create(pStatus_->arena(), type);
   }
 
   ParseNode* createNode(const Token& token)
   {
-    ParseNode* pNode = ParseNode::create(token);
-    pStatus_->recordNodeLocation(token.position(), pNode);
-    return pNode;
+    return ParseNode::create(pStatus_->arena(), token);
   }
 
   void skipSemicolons()
@@ -614,6 +1061,8 @@ private:
 
 public:
 
+  // Parse the document. The tree returned is owned by 'pStatus', and is
+  // freed when it's destroyed.
   ParseNode* parse(ParseStatus* pStatus)
   {
     pStatus_ = pStatus;
@@ -621,16 +1070,50 @@ public:
 
     while (true)
     {
-      ParseNode* pNode = parseExpression();
+      ExpressionStart start = expressionStart(utils::size(pStatus_->getErrors()));
+      ParseNode* pNode = parseTopLevelExpression();
       if (!pNode)
         break;
 
       root->add(pNode);
+      pStatus_->addExpressionStart(start);
     }
 
+    pStatus_->setRoot(root, code_, n_);
     return root;
   }
 
+  // Parse the next top-level expression into 'pStatus' (without adding
+  // it to a tree), or return NULL at the end of the document.
+  ParseNode* parseNext(ParseStatus* pStatus)
+  {
+    pStatus_ = pStatus;
+    return parseTopLevelExpression();
+  }
+
+  // The offset of the next token to be parsed, or -1 at the end of the
+  // document.
+  index_type offset() const
+  {
+    return token_.offset();
+  }
+
+  // Where the next top-level expression starts, given the number of errors
+  // found before it (see 'ExpressionStart'). We can only tell that no
+  // brackets were open before the next token if we haven't looked past it,
+  // and it didn't close one.
+  ExpressionStart expressionStart(index_type errors) const
+  {
+    ExpressionStart start(token_.offset(), errors);
+    start.position = token_.position();
+    start.resumable =
+      token_.offset() != -1 &&
+      !tokenizer_.buffered() &&
+      tokenizer_.stack().empty() &&
+      *token_.begin() != ']';
+    return start;
+  }
+
 };
 
 } // namespace parser
@@ -6,5 +6,8 @@
 #include <sourcetools/parse/ParseError.h>
 #include <sourcetools/parse/ParseStatus.h>
 #include <sourcetools/parse/Parser.h>
+#include <sourcetools/parse/IncrementalParser.h>
+#include <sourcetools/parse/ParallelParser.h>
+#include <sourcetools/parse/FlatTree.h>
 
 #endif /* SOURCETOOLS_PARSE_PARSE_H */
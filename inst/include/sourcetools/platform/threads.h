@@ -0,0 +1,73 @@
+#ifndef SOURCETOOLS_PLATFORM_THREADS_H
+#define SOURCETOOLS_PLATFORM_THREADS_H
+
+#include <vector>
+
+#include <sourcetools/core/config.h>
+#include <sourcetools/platform/platform.h>
+
+#ifdef SOURCETOOLS_COMPILER_CXX11
+# include <thread>
+#endif
+
+namespace sourcetools {
+namespace threads {
+
+// Chunks smaller than this aren't worth a thread of their own.
+static const index_type DEFAULT_CHUNK_SIZE = 1 << 20;
+
+// The size of the chunks to split 'n' bytes into for 'threads' threads:
+// 'chunkSize', or less, so that each thread gets a chunk.
+inline index_type chunkSize(index_type n, index_type threads, index_type chunkSize)
+{
+  if (chunkSize < 1)
+    chunkSize = 1;
+  if (n / chunkSize < threads)
+    chunkSize = n / threads;
+  return chunkSize < 1 ? 1 : chunkSize;
+}
+
+// Call 'pObject->*method' on each item, using up to 'threads' threads
+// (thread 't' takes items 't', 't + threads', and so on). Without C++11
+// support, the items are processed one after another on the calling
+// thread.
+template <typename T, typename Item>
+void forEach(T* pObject,
+             void (T::*method)(Item*),
+             std::vector<Item>* pItems,
+             index_type threads)
+{
+  index_type n = pItems->size();
+
+#ifdef SOURCETOOLS_COMPILER_CXX11
+  if (threads > n)
+    threads = n;
+
+  if (threads > 1)
+  {
+    std::vector<std::thread> workers;
+    for (index_type t = 0; t < threads; ++t)
+    {
+      workers.push_back(std::thread([=]() {
+        for (index_type i = t; i < n; i += threads)
+          (pObject->*method)(&(*pItems)[i]);
+      }));
+    }
+
+    for (index_type t = 0; t < threads; ++t)
+      workers[t].join();
+
+    return;
+  }
+#else
+  (void) threads;
+#endif
+
+  for (index_type i = 0; i < n; ++i)
+    (pObject->*method)(&(*pItems)[i]);
+}
+
+} // namespace threads
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_PLATFORM_THREADS_H */
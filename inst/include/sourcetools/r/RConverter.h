@@ -15,6 +15,11 @@ inline SEXP createChar(const std::string& data)
   return Rf_mkCharLenCE(data.c_str(), data.size(), CE_UTF8);
 }
 
+inline SEXP createChar(const char* data, index_type n)
+{
+  return Rf_mkCharLenCE(data, n, CE_UTF8);
+}
+
 inline SEXP createString(const std::string& data)
 {
   Protect protect;
@@ -4,6 +4,7 @@
 #include <string>
 #include <set>
 
+#include <sourcetools/collection/LineIndex.h>
 #include <sourcetools/r/RUtils.h>
 
 namespace sourcetools {
@@ -68,6 +69,34 @@ inline void listToDataFrame(SEXP listSEXP, int n)
   Rf_setAttrib(listSEXP, R_RowNamesSymbol, rownamesSEXP);
 }
 
+// The unit in which columns are reported, as named from R: "bytes",
+// "chars" (code points) or "utf16".
+inline collections::ColumnUnit columnUnit(SEXP unitSEXP)
+{
+  if (Rf_length(unitSEXP) == 0)
+    return collections::COLUMN_BYTES;
+
+  std::string unit = CHAR(STRING_ELT(unitSEXP, 0));
+  if (unit == "chars")
+    return collections::COLUMN_CODE_POINTS;
+  else if (unit == "utf16")
+    return collections::COLUMN_UTF16;
+  return collections::COLUMN_BYTES;
+}
+
+// Columns counted in characters assume the text is UTF-8; warn if it
+// isn't, since each malformed byte is then counted as one character.
+inline void checkColumnUnit(const collections::LineIndex& index,
+                            collections::ColumnUnit unit)
+{
+  if (unit == collections::COLUMN_BYTES || index.valid())
+    return;
+
+  Rf_warning("invalid UTF-8 at byte %d; columns past it count each "
+             "malformed byte as one character",
+             static_cast<int>(index.malformed()) + 1);
+}
+
 inline SEXP functionBody(SEXP fnSEXP)
 {
   SEXP bodyFunctionSEXP = Rf_findFun(Rf_install("body"), R_BaseNamespace);
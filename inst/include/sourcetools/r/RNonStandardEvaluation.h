@@ -1,7 +1,7 @@
 #ifndef SOURCETOOLS_R_R_NON_STANDARD_EVALUATION_H
 #define SOURCETOOLS_R_R_NON_STANDARD_EVALUATION_H
 
-#include <set>
+#include <cstring>
 #include <map>
 
 #include <sourcetools/r/RHeaders.h>
@@ -13,23 +13,22 @@ namespace nse {
 
 namespace detail {
 
-inline std::set<std::string> makeNsePrimitives()
-{
-  std::set<std::string> instance;
-
-  instance.insert("quote");
-  instance.insert("substitute");
-  instance.insert("eval");
-  instance.insert("evalq");
-  instance.insert("lazy_dots");
-
-  return instance;
-}
+// Functions known to evaluate their arguments non-standardly.
+static const char* const NSE_PRIMITIVES[] = {
+  "quote",
+  "substitute",
+  "eval",
+  "evalq",
+  "lazy_dots"
+};
 
-inline std::set<std::string>& nsePrimitives()
+inline bool isNsePrimitive(const char* name)
 {
-  static std::set<std::string> instance = makeNsePrimitives();
-  return instance;
+  index_type n = sizeof(NSE_PRIMITIVES) / sizeof(NSE_PRIMITIVES[0]);
+  for (index_type i = 0; i < n; ++i)
+    if (std::strcmp(NSE_PRIMITIVES[i], name) == 0)
+      return true;
+  return false;
 }
 
 class PerformsNonStandardEvaluationOperation
@@ -52,9 +51,9 @@ public:
 
     SEXP fnSEXP = CAR(dataSEXP);
     if (TYPEOF(fnSEXP) == SYMSXP)
-      status_ = nsePrimitives().count(CHAR(PRINTNAME(fnSEXP)));
+      status_ = isNsePrimitive(CHAR(PRINTNAME(fnSEXP)));
     else if (TYPEOF(fnSEXP) == STRSXP)
-      status_ = nsePrimitives().count(CHAR(STRING_ELT(fnSEXP, 0)));
+      status_ = isNsePrimitive(CHAR(STRING_ELT(fnSEXP, 0)));
 
   }
 
@@ -87,61 +86,39 @@ private:
 
 } // namespace detail
 
+inline bool performsNonStandardEvaluation(SEXP fnSEXP)
+{
+  typedef detail::PerformsNonStandardEvaluationOperation Operation;
+  scoped_ptr<Operation> operation(new Operation);
+
+  r::CallRecurser recurser(fnSEXP);
+  recurser.add(operation);
+  recurser.run();
+
+  return operation->status();
+}
+
+// Remembers which functions perform non-standard evaluation. Results are
+// keyed by address, so a database should only be kept for as long as the
+// functions it has seen are (e.g. for one call from R).
 class Database
 {
 public:
   bool check(SEXP dataSEXP)
   {
-    if (contains(dataSEXP))
-      return get(dataSEXP);
-
-    typedef detail::PerformsNonStandardEvaluationOperation Operation;
-    scoped_ptr<Operation> operation(new Operation);
-
-    r::CallRecurser recurser(dataSEXP);
-    recurser.add(operation);
-    recurser.run();
+    std::map<SEXP, bool>::const_iterator it = map_.find(dataSEXP);
+    if (it != map_.end())
+      return it->second;
 
-    set(dataSEXP, operation->status());
-    return operation->status();
+    bool result = performsNonStandardEvaluation(dataSEXP);
+    map_[dataSEXP] = result;
+    return result;
   }
 
 private:
-
-  bool contains(SEXP dataSEXP)
-  {
-    return map_.count(address(dataSEXP));
-  }
-
-  bool get(SEXP dataSEXP)
-  {
-    return map_[address(dataSEXP)];
-  }
-
-  void set(SEXP dataSEXP, bool value)
-  {
-    map_[address(dataSEXP)] = value;
-  }
-
-  std::size_t address(SEXP dataSEXP)
-  {
-    return reinterpret_cast<std::size_t>(dataSEXP);
-  }
-
-  std::map<std::size_t, bool> map_;
+  std::map<SEXP, bool> map_;
 };
 
-inline Database& database()
-{
-  static Database instance;
-  return instance;
-}
-
-inline bool performsNonStandardEvaluation(SEXP fnSEXP)
-{
-  return database().check(fnSEXP);
-}
-
 } // namespace nse
 } // namespace r
 } // namespace sourcetools
@@ -0,0 +1,357 @@
+#ifndef SOURCETOOLS_SIMD_SIMD_H
+#define SOURCETOOLS_SIMD_SIMD_H
+
+#include <cstring>
+
+#include <sourcetools/core/config.h>
+#include <sourcetools/core/macros.h>
+#include <sourcetools/platform/platform.h>
+
+// Vectorized byte scanning. SSE2 is part of the x86-64 baseline, so it
+// is always used there; the AVX2 kernels are compiled with a function-level
+// target attribute and selected at runtime when the CPU supports them.
+// Define SOURCETOOLS_SIMD_DISABLE to force the scalar code paths.
+#ifndef SOURCETOOLS_SIMD_DISABLE
+
+# if defined(__SSE2__) || defined(_M_X64)
+#  define SOURCETOOLS_SIMD_SSE2
+#  include <emmintrin.h>
+# endif
+
+# if defined(SOURCETOOLS_SIMD_SSE2) && defined(__AVX2__)
+#  define SOURCETOOLS_SIMD_AVX2
+#  include <immintrin.h>
+# elif defined(SOURCETOOLS_SIMD_SSE2) &&                                 \
+       !defined(SOURCETOOLS_PLATFORM_WINDOWS) &&                        \
+       (defined(__clang__) ||                                           \
+        (defined(__GNUC__) &&                                           \
+         (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#  define SOURCETOOLS_SIMD_AVX2
+#  define SOURCETOOLS_SIMD_AVX2_DISPATCH
+#  include <immintrin.h>
+# endif
+
+#endif /* SOURCETOOLS_SIMD_DISABLE */
+
+#ifdef SOURCETOOLS_SIMD_AVX2_DISPATCH
+# define SOURCETOOLS_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+# define SOURCETOOLS_SIMD_TARGET_AVX2
+#endif
+
+namespace sourcetools {
+namespace simd {
+
+namespace detail {
+
+inline int lowestBit(unsigned int mask)
+{
+#ifdef __GNUC__
+  return __builtin_ctz(mask);
+#else
+  int index = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    ++index;
+  }
+  return index;
+#endif
+}
+
+inline int highestBit(unsigned int mask)
+{
+#ifdef __GNUC__
+  return 31 - __builtin_clz(mask);
+#else
+  int index = 31;
+  while (!(mask & 0x80000000u)) {
+    mask <<= 1;
+    --index;
+  }
+  return index;
+#endif
+}
+
+inline int bitCount(unsigned int mask)
+{
+#ifdef __GNUC__
+  return __builtin_popcount(mask);
+#else
+  int count = 0;
+  for (; mask; mask &= mask - 1)
+    ++count;
+  return count;
+#endif
+}
+
+// Scalar fallbacks; also used to finish the tail of a vectorized scan.
+inline const char* findScalar(const char* it, const char* end,
+                              char a, char b, char c)
+{
+  for (; it < end; ++it)
+    if (*it == a || *it == b || *it == c)
+      return it;
+  return end;
+}
+
+inline index_type countScalar(const char* it, const char* end, char ch)
+{
+  index_type count = 0;
+  for (; it < end; ++it)
+    count += *it == ch;
+  return count;
+}
+
+inline const char* rfindScalar(const char* begin, const char* it, char ch)
+{
+  while (it > begin)
+    if (*--it == ch)
+      return it;
+  return NULL;
+}
+
+inline const char* findNonAsciiScalar(const char* it, const char* end, char ch)
+{
+  for (; it < end; ++it)
+    if ((*it & 0x80) || *it == ch)
+      return it;
+  return end;
+}
+
+#ifdef SOURCETOOLS_SIMD_SSE2
+
+inline unsigned int matchSSE2(const char* data,
+                              __m128i a, __m128i b, __m128i c)
+{
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  __m128i result = _mm_or_si128(
+    _mm_or_si128(_mm_cmpeq_epi8(block, a), _mm_cmpeq_epi8(block, b)),
+    _mm_cmpeq_epi8(block, c));
+  return static_cast<unsigned int>(_mm_movemask_epi8(result));
+}
+
+inline const char* findSSE2(const char* it, const char* end,
+                            char a, char b, char c)
+{
+  __m128i va = _mm_set1_epi8(a);
+  __m128i vb = _mm_set1_epi8(b);
+  __m128i vc = _mm_set1_epi8(c);
+  for (; end - it >= 16; it += 16) {
+    unsigned int mask = matchSSE2(it, va, vb, vc);
+    if (mask)
+      return it + lowestBit(mask);
+  }
+  return findScalar(it, end, a, b, c);
+}
+
+inline index_type countSSE2(const char* it, const char* end, char ch)
+{
+  __m128i needle = _mm_set1_epi8(ch);
+  index_type count = 0;
+  for (; end - it >= 16; it += 16)
+    count += bitCount(matchSSE2(it, needle, needle, needle));
+  return count + countScalar(it, end, ch);
+}
+
+inline const char* rfindSSE2(const char* begin, const char* it, char ch)
+{
+  __m128i needle = _mm_set1_epi8(ch);
+  for (; it - begin >= 16; it -= 16) {
+    unsigned int mask = matchSSE2(it - 16, needle, needle, needle);
+    if (mask)
+      return it - 16 + highestBit(mask);
+  }
+  return rfindScalar(begin, it, ch);
+}
+
+// Bytes outside the ASCII range have their high bit set, which is exactly
+// what 'movemask' extracts; matches against 'ch' are all ones.
+inline const char* findNonAsciiSSE2(const char* it, const char* end, char ch)
+{
+  __m128i needle = _mm_set1_epi8(ch);
+  for (; end - it >= 16; it += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+    unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+      _mm_or_si128(block, _mm_cmpeq_epi8(block, needle))));
+    if (mask)
+      return it + lowestBit(mask);
+  }
+  return findNonAsciiScalar(it, end, ch);
+}
+
+#endif /* SOURCETOOLS_SIMD_SSE2 */
+
+#ifdef SOURCETOOLS_SIMD_AVX2
+
+SOURCETOOLS_SIMD_TARGET_AVX2
+inline unsigned int matchAVX2(const char* data,
+                              __m256i a, __m256i b, __m256i c)
+{
+  __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+  __m256i result = _mm256_or_si256(
+    _mm256_or_si256(_mm256_cmpeq_epi8(block, a), _mm256_cmpeq_epi8(block, b)),
+    _mm256_cmpeq_epi8(block, c));
+  return static_cast<unsigned int>(_mm256_movemask_epi8(result));
+}
+
+SOURCETOOLS_SIMD_TARGET_AVX2
+inline const char* findAVX2(const char* it, const char* end,
+                            char a, char b, char c)
+{
+  __m256i va = _mm256_set1_epi8(a);
+  __m256i vb = _mm256_set1_epi8(b);
+  __m256i vc = _mm256_set1_epi8(c);
+  for (; end - it >= 32; it += 32) {
+    unsigned int mask = matchAVX2(it, va, vb, vc);
+    if (mask)
+      return it + lowestBit(mask);
+  }
+  return findSSE2(it, end, a, b, c);
+}
+
+SOURCETOOLS_SIMD_TARGET_AVX2
+inline index_type countAVX2(const char* it, const char* end, char ch)
+{
+  __m256i needle = _mm256_set1_epi8(ch);
+  index_type count = 0;
+  for (; end - it >= 32; it += 32)
+    count += bitCount(matchAVX2(it, needle, needle, needle));
+  return count + countSSE2(it, end, ch);
+}
+
+SOURCETOOLS_SIMD_TARGET_AVX2
+inline const char* rfindAVX2(const char* begin, const char* it, char ch)
+{
+  __m256i needle = _mm256_set1_epi8(ch);
+  for (; it - begin >= 32; it -= 32) {
+    unsigned int mask = matchAVX2(it - 32, needle, needle, needle);
+    if (mask)
+      return it - 32 + highestBit(mask);
+  }
+  return rfindSSE2(begin, it, ch);
+}
+
+SOURCETOOLS_SIMD_TARGET_AVX2
+inline const char* findNonAsciiAVX2(const char* it, const char* end, char ch)
+{
+  __m256i needle = _mm256_set1_epi8(ch);
+  for (; end - it >= 32; it += 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+    unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(
+      _mm256_or_si256(block, _mm256_cmpeq_epi8(block, needle))));
+    if (mask)
+      return it + lowestBit(mask);
+  }
+  return findNonAsciiSSE2(it, end, ch);
+}
+
+#endif /* SOURCETOOLS_SIMD_AVX2 */
+
+// The answer is computed once, on first use, and never changes; as with
+// the keyword table, an immutable function-local static is safe to share
+// between threads (only mutable ones are not).
+inline bool hasAVX2()
+{
+#if defined(SOURCETOOLS_SIMD_AVX2_DISPATCH)
+  static const bool result = __builtin_cpu_supports("avx2");
+  return result;
+#elif defined(SOURCETOOLS_SIMD_AVX2)
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Spans shorter than this don't amortize the cost of the AVX2 dispatch.
+static const index_type kAVX2Threshold = 64;
+
+} // namespace detail
+
+// Find the first byte in [begin, end) equal to any of 'a', 'b' or 'c',
+// returning 'end' if there is no such byte.
+inline const char* find(const char* begin, const char* end,
+                        char a, char b, char c)
+{
+#if defined(SOURCETOOLS_SIMD_AVX2)
+  if (end - begin >= detail::kAVX2Threshold && detail::hasAVX2())
+    return detail::findAVX2(begin, end, a, b, c);
+#endif
+
+#if defined(SOURCETOOLS_SIMD_SSE2)
+  return detail::findSSE2(begin, end, a, b, c);
+#else
+  return detail::findScalar(begin, end, a, b, c);
+#endif
+}
+
+inline const char* find(const char* begin, const char* end, char a, char b)
+{
+  return find(begin, end, a, b, b);
+}
+
+inline const char* find(const char* begin, const char* end, char ch)
+{
+  if (begin >= end)
+    return end;
+
+  const void* result = std::memchr(begin, ch, end - begin);
+  return result ? static_cast<const char*>(result) : end;
+}
+
+// Count the bytes in [begin, end) equal to 'ch'.
+inline index_type count(const char* begin, const char* end, char ch)
+{
+#if defined(SOURCETOOLS_SIMD_AVX2)
+  if (end - begin >= detail::kAVX2Threshold && detail::hasAVX2())
+    return detail::countAVX2(begin, end, ch);
+#endif
+
+#if defined(SOURCETOOLS_SIMD_SSE2)
+  return detail::countSSE2(begin, end, ch);
+#else
+  return detail::countScalar(begin, end, ch);
+#endif
+}
+
+// Find the last byte in [begin, end) equal to 'ch', returning NULL
+// if there is no such byte.
+inline const char* rfind(const char* begin, const char* end, char ch)
+{
+#if defined(SOURCETOOLS_SIMD_AVX2)
+  if (end - begin >= detail::kAVX2Threshold && detail::hasAVX2())
+    return detail::rfindAVX2(begin, end, ch);
+#endif
+
+#if defined(SOURCETOOLS_SIMD_SSE2)
+  return detail::rfindSSE2(begin, end, ch);
+#else
+  return detail::rfindScalar(begin, end, ch);
+#endif
+}
+
+// Find the first byte in [begin, end) that lies outside the ASCII range,
+// or is equal to 'ch', returning 'end' if there is no such byte. (Pass a
+// non-ASCII 'ch', e.g. '\x80', to look for non-ASCII bytes only.)
+inline const char* findNonAscii(const char* begin, const char* end, char ch)
+{
+#if defined(SOURCETOOLS_SIMD_AVX2)
+  if (end - begin >= detail::kAVX2Threshold && detail::hasAVX2())
+    return detail::findNonAsciiAVX2(begin, end, ch);
+#endif
+
+#if defined(SOURCETOOLS_SIMD_SSE2)
+  return detail::findNonAsciiSSE2(begin, end, ch);
+#else
+  return detail::findNonAsciiScalar(begin, end, ch);
+#endif
+}
+
+inline const char* findNonAscii(const char* begin, const char* end)
+{
+  return findNonAscii(begin, end, '\x80');
+}
+
+} // namespace simd
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_SIMD_SIMD_H */
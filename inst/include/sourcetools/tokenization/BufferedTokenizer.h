@@ -0,0 +1,134 @@
+#ifndef SOURCETOOLS_TOKENIZATION_BUFFERED_TOKENIZER_H
+#define SOURCETOOLS_TOKENIZATION_BUFFERED_TOKENIZER_H
+
+#include <vector>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/tokenization/Token.h>
+#include <sourcetools/tokenization/Tokenizer.h>
+
+namespace sourcetools {
+namespace tokenizer {
+
+// Wraps a tokenizer with a lookahead buffer, so that peeking ahead doesn't
+// need to copy the tokenizer and re-tokenize what it's looking at. Each
+// token is tokenized exactly once: tokens produced by 'peek()' are kept
+// in a ring buffer (grown as needed) until 'tokenize()' hands them out.
+template <typename Tokenizer>
+class BufferedTokenizer
+{
+private:
+  typedef tokens::Token Token;
+
+public:
+
+  static const index_type INITIAL_CAPACITY = 8;
+
+  BufferedTokenizer(const char* code, index_type n, bool trackPositions = true)
+    : tokenizer_(code, n, trackPositions),
+      buffer_(INITIAL_CAPACITY),
+      head_(0),
+      size_(0),
+      end_(tokens::END)
+  {
+  }
+
+  // Resume tokenization at 'offset'; see the corresponding constructor of
+  // 'BasicTokenizer'.
+  BufferedTokenizer(const char* code,
+                    index_type n,
+                    index_type offset,
+                    const collections::Position& position,
+                    const std::vector<tokens::TokenType>& stack,
+                    bool trackPositions = true)
+    : tokenizer_(code, n, offset, position, stack, trackPositions),
+      buffer_(INITIAL_CAPACITY),
+      head_(0),
+      size_(0),
+      end_(tokens::END)
+  {
+  }
+
+  void setSymbolTable(collections::SymbolTable* pSymbols)
+  {
+    tokenizer_.setSymbolTable(pSymbols);
+  }
+
+  bool tokenize(Token* pToken)
+  {
+    if (size_ == 0)
+      return tokenizer_.tokenize(pToken);
+
+    *pToken = buffer_[head_];
+    head_ = (head_ + 1) & mask();
+    --size_;
+    return true;
+  }
+
+  // Returns the 'lookahead'th token to come (the next token for a
+  // lookahead of 1), or an END token if there aren't that many. As with
+  // 'Tokenizer::peek()', a lookahead of 0 also gives an END token. The
+  // reference is valid until the next call to 'peek()'.
+  const Token& peek(index_type lookahead = 1)
+  {
+    if (lookahead < 1)
+      return end_;
+
+    while (size_ < lookahead)
+    {
+      Token token;
+      if (!tokenizer_.tokenize(&token))
+        return end_;
+      push(token);
+    }
+
+    return buffer_[(head_ + lookahead - 1) & mask()];
+  }
+
+  // Whether tokens have been looked ahead at, and not yet handed out.
+  bool buffered() const { return size_ > 0; }
+
+  // The stack of open '[' / '[[' brackets, after the last token tokenized
+  // (which, if 'buffered()', is past the last token handed out).
+  const std::vector<tokens::TokenType>& stack() const
+  {
+    return tokenizer_.stack();
+  }
+
+private:
+
+  index_type mask() const
+  {
+    return static_cast<index_type>(buffer_.size()) - 1;
+  }
+
+  void push(const Token& token)
+  {
+    if (size_ == static_cast<index_type>(buffer_.size()))
+      grow();
+
+    buffer_[(head_ + size_) & mask()] = token;
+    ++size_;
+  }
+
+  void grow()
+  {
+    std::vector<Token> buffer(buffer_.size() * 2);
+    for (index_type i = 0; i < size_; ++i)
+      buffer[i] = buffer_[(head_ + i) & mask()];
+
+    buffer_.swap(buffer);
+    head_ = 0;
+  }
+
+  Tokenizer tokenizer_;
+  std::vector<Token> buffer_;
+  index_type head_;
+  index_type size_;
+  Token end_;
+};
+
+} // namespace tokenizer
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_TOKENIZATION_BUFFERED_TOKENIZER_H */
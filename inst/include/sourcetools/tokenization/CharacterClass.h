@@ -0,0 +1,154 @@
+#ifndef SOURCETOOLS_TOKENIZATION_CHARACTER_CLASS_H
+#define SOURCETOOLS_TOKENIZATION_CHARACTER_CLASS_H
+
+#include <sourcetools/tokenization/Registration.h>
+
+namespace sourcetools {
+namespace tokenizer {
+
+// The tokenizer decides how to consume a token by looking at its first
+// character. Rather than testing that character against each candidate
+// in turn, we classify it with a single table lookup and dispatch on
+// the result.
+//
+// Classes from CHARACTER_CLASS_DIGIT onwards are exactly those that can
+// appear within a symbol (after its first character).
+enum CharacterClass
+{
+  CHARACTER_CLASS_INVALID,
+  CHARACTER_CLASS_SINGLE,       // single-character token; see 'singleCharacterTokenType()'
+  CHARACTER_CLASS_WHITESPACE,
+  CHARACTER_CLASS_LBRACKET,     // '[', '[['
+  CHARACTER_CLASS_RBRACKET,     // ']', ']]'
+  CHARACTER_CLASS_LESS,         // '<', '<=', '<-', '<<-'
+  CHARACTER_CLASS_GREATER,      // '>', '>='
+  CHARACTER_CLASS_EQUAL,        // '=', '==', '=>'
+  CHARACTER_CLASS_PIPE,         // '|', '||', '|>'
+  CHARACTER_CLASS_AMPERSAND,    // '&', '&&'
+  CHARACTER_CLASS_STAR,         // '*', '**'
+  CHARACTER_CLASS_COLON,        // ':', '::', ':::', ':='
+  CHARACTER_CLASS_BANG,         // '!', '!='
+  CHARACTER_CLASS_MINUS,        // '-', '->', '->>'
+  CHARACTER_CLASS_PERCENT,      // user operators
+  CHARACTER_CLASS_QUOTE,        // single-quoted strings
+  CHARACTER_CLASS_DOUBLE_QUOTE, // double-quoted strings
+  CHARACTER_CLASS_BACKTICK,     // quoted symbols
+  CHARACTER_CLASS_HASH,         // comments
+  CHARACTER_CLASS_DIGIT,        // numbers
+  CHARACTER_CLASS_DOT,          // numbers ('.5') or symbols ('.x')
+  CHARACTER_CLASS_RAW,          // raw strings ('r"(...)"') or symbols
+  CHARACTER_CLASS_SYMBOL,
+  CHARACTER_CLASS_UNDERSCORE    // valid within, but not at the start of, a symbol
+};
+
+// The token types that are fully determined by a single character, from
+// the registered list of such tokens: 'SingleCharacterTokenType<ch>' is
+// the type of the token for character 'ch', or INVALID if there's none.
+template <int C>
+struct SingleCharacterTokenType
+{
+  static const tokens::TokenType value = tokens::INVALID;
+};
+
+#define SOURCETOOLS_SINGLE_CHARACTER_SPECIALIZATION(__CH__, __TYPE__)     \
+  template <>                                                            \
+  struct SingleCharacterTokenType<__CH__>                                \
+  {                                                                      \
+    static const tokens::TokenType value = tokens::__TYPE__;             \
+  };
+
+SOURCE_TOOLS_SINGLE_CHARACTER_TOKENS(SOURCETOOLS_SINGLE_CHARACTER_SPECIALIZATION)
+
+#undef SOURCETOOLS_SINGLE_CHARACTER_SPECIALIZATION
+
+#define SOURCETOOLS_SINGLE_CHARACTER_TOKEN_TYPE(__CH__)                   \
+  (SingleCharacterTokenType<(__CH__)>::value)
+
+#define SOURCETOOLS_CHARACTER_CLASS(__CH__)                               \
+  (SOURCETOOLS_SINGLE_CHARACTER_TOKEN_TYPE(__CH__) != tokens::INVALID ?  \
+     CHARACTER_CLASS_SINGLE :                                            \
+   (__CH__) == ' '  || (__CH__) == '\f' || (__CH__) == '\r' ||           \
+   (__CH__) == '\n' || (__CH__) == '\t' || (__CH__) == '\v' ?            \
+     CHARACTER_CLASS_WHITESPACE :                                        \
+   (__CH__) == '['  ? CHARACTER_CLASS_LBRACKET     :                     \
+   (__CH__) == ']'  ? CHARACTER_CLASS_RBRACKET     :                     \
+   (__CH__) == '<'  ? CHARACTER_CLASS_LESS         :                     \
+   (__CH__) == '>'  ? CHARACTER_CLASS_GREATER      :                     \
+   (__CH__) == '='  ? CHARACTER_CLASS_EQUAL        :                     \
+   (__CH__) == '|'  ? CHARACTER_CLASS_PIPE         :                     \
+   (__CH__) == '&'  ? CHARACTER_CLASS_AMPERSAND    :                     \
+   (__CH__) == '*'  ? CHARACTER_CLASS_STAR         :                     \
+   (__CH__) == ':'  ? CHARACTER_CLASS_COLON        :                     \
+   (__CH__) == '!'  ? CHARACTER_CLASS_BANG         :                     \
+   (__CH__) == '-'  ? CHARACTER_CLASS_MINUS        :                     \
+   (__CH__) == '%'  ? CHARACTER_CLASS_PERCENT      :                     \
+   (__CH__) == '\'' ? CHARACTER_CLASS_QUOTE        :                     \
+   (__CH__) == '"'  ? CHARACTER_CLASS_DOUBLE_QUOTE :                     \
+   (__CH__) == '`'  ? CHARACTER_CLASS_BACKTICK     :                     \
+   (__CH__) == '#'  ? CHARACTER_CLASS_HASH         :                     \
+   (__CH__) >= '0' && (__CH__) <= '9' ? CHARACTER_CLASS_DIGIT :          \
+   (__CH__) == '.'  ? CHARACTER_CLASS_DOT          :                     \
+   (__CH__) == 'r'  || (__CH__) == 'R' ? CHARACTER_CLASS_RAW :           \
+   ((__CH__) >= 'a' && (__CH__) <= 'z') ||                               \
+   ((__CH__) >= 'A' && (__CH__) <= 'Z') ||                               \
+   (__CH__) >= 0x80 ? CHARACTER_CLASS_SYMBOL :                           \
+   (__CH__) == '_'  ? CHARACTER_CLASS_UNDERSCORE   :                     \
+   CHARACTER_CLASS_INVALID)
+
+#define SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, __N__)                 \
+  __MACRO__((__N__) +  0), __MACRO__((__N__) +  1),                       \
+  __MACRO__((__N__) +  2), __MACRO__((__N__) +  3),                       \
+  __MACRO__((__N__) +  4), __MACRO__((__N__) +  5),                       \
+  __MACRO__((__N__) +  6), __MACRO__((__N__) +  7),                       \
+  __MACRO__((__N__) +  8), __MACRO__((__N__) +  9),                       \
+  __MACRO__((__N__) + 10), __MACRO__((__N__) + 11),                       \
+  __MACRO__((__N__) + 12), __MACRO__((__N__) + 13),                       \
+  __MACRO__((__N__) + 14), __MACRO__((__N__) + 15)
+
+#define SOURCETOOLS_CHARACTER_TABLE(__MACRO__)                            \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__,   0),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__,  16),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__,  32),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__,  48),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__,  64),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__,  80),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__,  96),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 112),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 128),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 144),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 160),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 176),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 192),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 208),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 224),                        \
+  SOURCETOOLS_CHARACTER_TABLE_ROW(__MACRO__, 240)
+
+// Both tables are constant-initialized, so there is no run-time cost
+// (or thread-safety concern) in building them.
+inline CharacterClass characterClass(char ch)
+{
+  static const unsigned char table[256] = {
+    SOURCETOOLS_CHARACTER_TABLE(SOURCETOOLS_CHARACTER_CLASS)
+  };
+
+  return static_cast<CharacterClass>(table[static_cast<unsigned char>(ch)]);
+}
+
+inline tokens::TokenType singleCharacterTokenType(char ch)
+{
+  static const tokens::TokenType table[256] = {
+    SOURCETOOLS_CHARACTER_TABLE(SOURCETOOLS_SINGLE_CHARACTER_TOKEN_TYPE)
+  };
+
+  return table[static_cast<unsigned char>(ch)];
+}
+
+inline bool isValidForSymbol(char ch)
+{
+  return characterClass(ch) >= CHARACTER_CLASS_DIGIT;
+}
+
+} // namespace tokenizer
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_TOKENIZATION_CHARACTER_CLASS_H */
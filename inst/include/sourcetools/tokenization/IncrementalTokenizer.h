@@ -0,0 +1,253 @@
+#ifndef SOURCETOOLS_TOKENIZATION_INCREMENTAL_TOKENIZER_H
+#define SOURCETOOLS_TOKENIZATION_INCREMENTAL_TOKENIZER_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/collection/Position.h>
+#include <sourcetools/tokenization/Token.h>
+#include <sourcetools/tokenization/Tokenizer.h>
+
+namespace sourcetools {
+namespace tokenizer {
+
+// Updates the tokens of a document after an edit, re-tokenizing only the
+// neighborhood of the edit.
+//
+// The tokenizer looks at most two bytes past the end of a token when
+// deciding where it ends (e.g. '<' vs. '<<-'), so tokens ending two or
+// more bytes before the edit are unaffected by it. We restart at the
+// token containing that byte, and re-tokenize until we produce a token
+// that starts after the edited text, at the same place as an old token,
+// with the same stack of open '[' / '[[' brackets. From there on the old
+// tokens are still valid and only need to be shifted.
+class IncrementalTokenizer
+{
+private:
+  typedef tokens::Token Token;
+  typedef tokens::TokenType TokenType;
+  typedef collections::Position Position;
+
+public:
+
+  // Replace the bytes [begin, end) of '*pCode' with 'replacement', and
+  // update '*pTokens' (which must hold the tokens of '*pCode') to match.
+  IncrementalTokenizer(std::string* pCode,
+                       std::vector<Token>* pTokens,
+                       index_type begin,
+                       index_type end,
+                       const std::string& replacement)
+    : pCode_(pCode),
+      pTokens_(pTokens),
+      begin_(begin),
+      end_(end),
+      replacement_(replacement),
+      delta_(utils::size(replacement) - (end - begin)),
+      syncOffset_(0)
+  {
+  }
+
+  void run()
+  {
+    std::vector<Token>& tokens = *pTokens_;
+
+    // Find the token to restart from, and the tokenizer state there.
+    index_type start = restartIndex();
+    std::vector<TokenType> stack;
+    for (index_type i = 0; i < start; ++i)
+      updateStack(tokens[i].type(), *tokens[i].begin(), &stack);
+
+    // Remember the first byte of the tokens overlapping the edit; we'll
+    // need them to replay the old bracket stack once they're gone.
+    index_type count = utils::size(tokens);
+    index_type edited = start;
+    std::vector<char> firsts;
+    for (; edited < count && tokens[edited].offset() < end_; ++edited)
+      firsts.push_back(*tokens[edited].begin());
+
+    bool trackPositions = count == 0 || tokens[0].hasPosition();
+    index_type offset = start < count ? tokens[start].offset() : 0;
+    Position position = start < count ? tokens[start].position() : Position(0, 0);
+
+    // Apply the edit.
+    const char* previous = pCode_->data();
+    pCode_->replace(begin_, end_ - begin_, replacement_);
+    const char* code = pCode_->data();
+    index_type n = pCode_->size();
+
+    // Re-tokenize until we line up with the old tokens again.
+    Tokenizer tokenizer(code, n, offset, position, stack, trackPositions);
+    std::vector<TokenType> oldStack = stack;
+    std::vector<Token> fresh;
+    index_type sync = start;
+    index_type editEnd = begin_ + utils::size(replacement_);
+
+    Token token;
+    while (true)
+    {
+      index_type current = tokenizer.offset();
+      if (current >= editEnd)
+      {
+        index_type target = current - delta_;
+        for (; sync < count && tokens[sync].offset() < target; ++sync)
+        {
+          char first = sync < edited ?
+            firsts[sync - start] :
+            code[tokens[sync].offset() + delta_];
+          updateStack(tokens[sync].type(), first, &oldStack);
+        }
+
+        if (sync < count &&
+            tokens[sync].offset() == target &&
+            oldStack == tokenizer.stack())
+        {
+          break;
+        }
+      }
+
+      if (!tokenizer.tokenize(&token))
+      {
+        sync = count;
+        break;
+      }
+
+      fresh.push_back(token);
+    }
+
+    syncOffset_ = sync < count ? tokens[sync].offset() + delta_ : n;
+
+    // Re-point the tokens before the edit, if the text moved.
+    if (code != previous)
+    {
+      for (index_type i = 0; i < start; ++i)
+        tokens[i] = rebase(tokens[i], code);
+    }
+
+    // Shift the tokens that follow the edit into place, moving them over
+    // to make room for the new tokens in the same pass.
+    oldPosition_ = sync < count ? tokens[sync].position() : Position();
+    newPosition_ = tokenizer.position();
+    index_type difference = utils::size(fresh) - (sync - start);
+    if (difference > 0)
+    {
+      tokens.resize(count + difference);
+      for (index_type i = count - 1; i >= sync; --i)
+        tokens[i + difference] = shift(tokens[i], code, trackPositions);
+    }
+    else
+    {
+      for (index_type i = sync; i < count; ++i)
+        tokens[i + difference] = shift(tokens[i], code, trackPositions);
+      tokens.resize(count + difference);
+    }
+
+    // Splice in the new tokens.
+    std::copy(fresh.begin(), fresh.end(), tokens.begin() + start);
+  }
+
+  // The offset, in the edited text, of the first token that was shifted
+  // rather than re-tokenized (or the text's size, if there was none).
+  // Everything from there on tokenizes as it did before the edit.
+  index_type syncOffset() const { return syncOffset_; }
+
+  // The row, before the edit, of the first token that was shifted; of the
+  // positions from there on, only those on this row move sideways.
+  index_type syncRow() const { return oldPosition_.row; }
+
+  // How many rows the positions after the sync point have moved down by.
+  index_type rowShift() const { return newPosition_.row - oldPosition_.row; }
+
+  // Where a position at or after the sync point has moved to.
+  Position shift(const Position& position) const
+  {
+    Position result = position;
+    if (result.row == oldPosition_.row)
+      result.column += newPosition_.column - oldPosition_.column;
+    result.row += newPosition_.row - oldPosition_.row;
+    return result;
+  }
+
+  // Mirrors the tokenizer's handling of '[', '[[' and ']'.
+  static void updateStack(TokenType type, char first, std::vector<TokenType>* pStack)
+  {
+    if (type == tokens::LBRACKET || type == tokens::LDBRACKET)
+      pStack->push_back(type);
+    else if (first == ']' && !pStack->empty())
+      pStack->pop_back();
+  }
+
+private:
+
+  index_type restartIndex() const
+  {
+    const std::vector<Token>& tokens = *pTokens_;
+    index_type target = begin_ - 2;
+    index_type i = 0;
+
+    // Binary search for the last token starting at or before 'target'.
+    index_type lo = 0, hi = utils::size(tokens);
+    while (lo < hi)
+    {
+      index_type mid = lo + (hi - lo) / 2;
+      if (tokens[mid].offset() <= target) {
+        i = mid;
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    return i;
+  }
+
+  Token shift(const Token& token,
+              const char* code,
+              bool trackPositions) const
+  {
+    // Copy the token, rather than re-creating it from its text (which may
+    // no longer be around), so that it keeps e.g. its newline count.
+    Token result = token;
+    result.move(code,
+                token.offset() + delta_,
+                trackPositions ? shift(token.position()) : token.position());
+    return result;
+  }
+
+  static Token rebase(const Token& token, const char* code)
+  {
+    Token result = token;
+    result.move(code, token.offset(), token.position());
+    return result;
+  }
+
+  std::string* pCode_;
+  std::vector<Token>* pTokens_;
+  index_type begin_;
+  index_type end_;
+  const std::string& replacement_;
+  index_type delta_;
+  index_type syncOffset_;
+  Position oldPosition_;
+  Position newPosition_;
+};
+
+} // namespace tokenizer
+
+// Replace the bytes [begin, end) of '*pCode' with 'replacement', updating
+// '*pTokens' (the tokens of '*pCode') to match. Only the tokens near the
+// edit are re-tokenized; the tokens after it are shifted into place.
+inline void retokenize(std::string* pCode,
+                       std::vector<tokens::Token>* pTokens,
+                       index_type begin,
+                       index_type end,
+                       const std::string& replacement)
+{
+  tokenizer::IncrementalTokenizer tokenizer(pCode, pTokens, begin, end, replacement);
+  tokenizer.run();
+}
+
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_TOKENIZATION_INCREMENTAL_TOKENIZER_H */
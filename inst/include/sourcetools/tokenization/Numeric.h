@@ -0,0 +1,196 @@
+#ifndef SOURCETOOLS_TOKENIZATION_NUMERIC_H
+#define SOURCETOOLS_TOKENIZATION_NUMERIC_H
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/tokenization/Token.h>
+
+namespace sourcetools {
+namespace tokens {
+
+enum NumericType
+{
+  NUMERIC_DOUBLE,
+  NUMERIC_INTEGER,
+  NUMERIC_COMPLEX
+};
+
+// The value of a numeric literal. R's complex literals (e.g. '2i') are
+// purely imaginary, so 'value' holds the imaginary part for those.
+struct NumericValue
+{
+  NumericValue()
+    : type(NUMERIC_DOUBLE), value(0)
+  {
+  }
+
+  NumericValue(NumericType type, double value)
+    : type(type), value(value)
+  {
+  }
+
+  NumericType type;
+  double value;
+};
+
+namespace detail {
+
+// Every power of ten up to 1E22 is exactly representable as a double.
+static const double EXACT_POWERS_OF_TEN[] = {
+  1E0,  1E1,  1E2,  1E3,  1E4,  1E5,  1E6,  1E7,  1E8,  1E9,  1E10, 1E11,
+  1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22
+};
+
+static const int MAX_EXACT_POWER_OF_TEN = 22;
+
+// Any integer of up to 15 digits is exactly representable as a double.
+static const int MAX_EXACT_DIGITS = 15;
+
+// Hand the literal to 'strtod()', which needs a nul-terminated copy. (R
+// keeps LC_NUMERIC set to "C", so the decimal point is always '.'.)
+inline double parseDecimalSlow(const char* begin, const char* end)
+{
+  char buffer[64];
+  index_type n = end - begin;
+  if (n < static_cast<index_type>(sizeof(buffer)))
+  {
+    std::memcpy(buffer, begin, n);
+    buffer[n] = '\0';
+    return std::strtod(buffer, NULL);
+  }
+
+  std::string copy(begin, end);
+  return std::strtod(copy.c_str(), NULL);
+}
+
+// Parse a decimal literal such as '12', '.5', '1.' or '1.5e-3'. Literals
+// with at most 15 significant digits, scaled by at most 1E22, are computed
+// exactly with a single multiplication or division (Clinger's fast path);
+// everything else goes through 'strtod()'.
+inline double parseDecimal(const char* begin, const char* end)
+{
+  double mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool truncated = false;
+
+  const char* it = begin;
+  for (; it != end && utils::isDigit(*it); ++it)
+  {
+    if (digits < MAX_EXACT_DIGITS)
+    {
+      mantissa = 10 * mantissa + (*it - '0');
+      digits += mantissa != 0;
+    }
+    else
+    {
+      truncated |= *it != '0';
+      ++exponent;
+    }
+  }
+
+  if (it != end && *it == '.')
+  {
+    for (++it; it != end && utils::isDigit(*it); ++it)
+    {
+      if (digits < MAX_EXACT_DIGITS)
+      {
+        mantissa = 10 * mantissa + (*it - '0');
+        digits += mantissa != 0;
+        --exponent;
+      }
+      else
+      {
+        truncated |= *it != '0';
+      }
+    }
+  }
+
+  if (it != end && (*it == 'e' || *it == 'E'))
+  {
+    ++it;
+
+    bool negative = it != end && *it == '-';
+    if (it != end && (*it == '-' || *it == '+'))
+      ++it;
+
+    int value = 0;
+    for (; it != end && utils::isDigit(*it); ++it)
+      if (value < 100000)
+        value = 10 * value + (*it - '0');
+
+    exponent += negative ? -value : value;
+  }
+
+  if (truncated)
+    return parseDecimalSlow(begin, end);
+
+  if (mantissa == 0)
+    return 0;
+
+  if (0 <= exponent && exponent <= MAX_EXACT_POWER_OF_TEN)
+    return mantissa * EXACT_POWERS_OF_TEN[exponent];
+
+  if (-MAX_EXACT_POWER_OF_TEN <= exponent && exponent < 0)
+    return mantissa / EXACT_POWERS_OF_TEN[-exponent];
+
+  return parseDecimalSlow(begin, end);
+}
+
+// Parse the digits of a hexadecimal literal (following the '0x'). As R
+// does, the value is accumulated in a double, so that literals too large
+// for an integer type still have a value.
+inline double parseHexadecimal(const char* begin, const char* end)
+{
+  double value = 0;
+  for (const char* it = begin; it != end; ++it)
+    value = 16 * value + hexValue(*it);
+  return value;
+}
+
+} // namespace detail
+
+// Decode a numeric literal, as tokenized by the tokenizer: a decimal or
+// hexadecimal number, optionally followed by 'L' (for an integer) or 'i'
+// (for an imaginary number). As in R, an 'L' literal that isn't a whole
+// number within the range of an integer (e.g. '1.5L') is a double.
+inline NumericValue numericValue(const char* begin, const char* end)
+{
+  if (begin == end)
+    return NumericValue();
+
+  char suffix = *(end - 1);
+  if (suffix == 'L' || suffix == 'i')
+    --end;
+
+  bool hexadecimal =
+    end - begin > 2 &&
+    begin[0] == '0' &&
+    (begin[1] == 'x' || begin[1] == 'X');
+
+  double value = hexadecimal ?
+    detail::parseHexadecimal(begin + 2, end) :
+    detail::parseDecimal(begin, end);
+
+  if (suffix == 'i')
+    return NumericValue(NUMERIC_COMPLEX, value);
+
+  if (suffix == 'L' && value <= INT_MAX && value == static_cast<int>(value))
+    return NumericValue(NUMERIC_INTEGER, value);
+
+  return NumericValue(NUMERIC_DOUBLE, value);
+}
+
+inline NumericValue numericValue(const Token& token)
+{
+  return numericValue(token.begin(), token.end());
+}
+
+} // namespace tokens
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_TOKENIZATION_NUMERIC_H */
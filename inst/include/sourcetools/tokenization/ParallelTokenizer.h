@@ -0,0 +1,217 @@
+#ifndef SOURCETOOLS_TOKENIZATION_PARALLEL_TOKENIZER_H
+#define SOURCETOOLS_TOKENIZATION_PARALLEL_TOKENIZER_H
+
+#include <vector>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/platform/platform.h>
+#include <sourcetools/platform/threads.h>
+#include <sourcetools/simd/simd.h>
+#include <sourcetools/collection/Position.h>
+#include <sourcetools/tokenization/Token.h>
+#include <sourcetools/tokenization/Tokenizer.h>
+
+namespace sourcetools {
+namespace tokenizer {
+
+// Tokenizes a large document in parallel, producing exactly the tokens
+// that the sequential tokenizer would.
+//
+// The document is split into chunks that start at the beginning of a
+// line, and each chunk is tokenized independently on the guess that no
+// token spans its start and that no '[' or '[[' is open there. The chunks
+// are then stitched together in order. A chunk's guess was right if the
+// previous chunk's last token ended exactly where the chunk starts, and
+// if the chunk never tried to close a '[' it didn't open itself while
+// brackets were open before it. (Between tokens, the bracket stack is the
+// tokenizer's only state.) Chunks whose guess was wrong are re-tokenized
+// from where the previous chunk left off, with the right bracket stack.
+class ParallelTokenizer
+{
+private:
+  typedef tokens::Token Token;
+  typedef tokens::TokenType TokenType;
+  typedef collections::Position Position;
+
+  struct Chunk
+  {
+    index_type begin;
+    index_type end;
+    Position position;
+    index_type newlines;
+
+    std::vector<Token> tokens;
+    std::vector<TokenType> stack;
+    bool underflow;
+    index_type stop;
+    Position stopPosition;
+  };
+
+public:
+
+  ParallelTokenizer(const char* code,
+                    index_type n,
+                    index_type threads,
+                    index_type chunkSize = threads::DEFAULT_CHUNK_SIZE)
+    : code_(code),
+      n_(n),
+      threads_(threads < 1 ? 1 : threads)
+  {
+    split(threads::chunkSize(n_, threads_, chunkSize));
+  }
+
+  std::vector<Token> tokenize()
+  {
+    std::vector<Token> result;
+    if (n_ == 0)
+      return result;
+
+    // Find where each chunk starts, in rows.
+    run(&ParallelTokenizer::countNewlines);
+    index_type row = 0;
+    for (std::size_t i = 0; i < chunks_.size(); ++i)
+    {
+      chunks_[i].position = Position(row, 0);
+      row += chunks_[i].newlines;
+    }
+
+    // Speculatively tokenize each chunk, then stitch them together.
+    run(&ParallelTokenizer::tokenizeChunk);
+    stitch();
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < chunks_.size(); ++i)
+      count += chunks_[i].tokens.size();
+
+    result.reserve(count);
+    for (std::size_t i = 0; i < chunks_.size(); ++i)
+    {
+      result.insert(result.end(), chunks_[i].tokens.begin(), chunks_[i].tokens.end());
+      std::vector<Token>().swap(chunks_[i].tokens);
+    }
+
+    return result;
+  }
+
+private:
+
+  void split(index_type chunkSize)
+  {
+    index_type begin = 0;
+    while (begin < n_)
+    {
+      index_type end = begin + chunkSize;
+      if (end >= n_) {
+        end = n_;
+      } else {
+        const char* newline = simd::find(code_ + end - 1, code_ + n_, '\n');
+        end = newline - code_ + (newline != code_ + n_);
+      }
+
+      Chunk chunk;
+      chunk.begin = begin;
+      chunk.end = end;
+      chunk.newlines = 0;
+      chunk.underflow = false;
+      chunk.stop = begin;
+      chunks_.push_back(chunk);
+
+      begin = end;
+    }
+  }
+
+  void countNewlines(Chunk* pChunk)
+  {
+    pChunk->newlines = simd::count(code_ + pChunk->begin, code_ + pChunk->end, '\n');
+  }
+
+  void tokenizeChunk(Chunk* pChunk)
+  {
+    pChunk->tokens.reserve((pChunk->end - pChunk->begin) / 4);
+    tokenizeChunk(pChunk, pChunk->begin, pChunk->position, std::vector<TokenType>());
+  }
+
+  void tokenizeChunk(Chunk* pChunk,
+                     index_type offset,
+                     const Position& position,
+                     const std::vector<TokenType>& stack)
+  {
+    Tokenizer tokenizer(code_, n_, offset, position, stack);
+
+    Token token;
+    pChunk->tokens.clear();
+    pChunk->underflow = false;
+    while (tokenizer.offset() < pChunk->end)
+    {
+      // Note when we try to close a bracket opened before this chunk.
+      if (code_[tokenizer.offset()] == ']' && tokenizer.stack().empty())
+        pChunk->underflow = true;
+
+      tokenizer.tokenize(&token);
+      pChunk->tokens.push_back(token);
+    }
+
+    pChunk->stack = tokenizer.stack();
+    pChunk->stop = tokenizer.offset();
+    pChunk->stopPosition = tokenizer.position();
+  }
+
+  void stitch()
+  {
+    std::vector<TokenType> stack;
+    index_type offset = 0;
+    Position position(0, 0);
+
+    for (std::size_t i = 0; i < chunks_.size(); ++i)
+    {
+      Chunk& chunk = chunks_[i];
+
+      bool valid =
+        chunk.begin == offset &&
+        (!chunk.underflow || stack.empty());
+
+      if (valid) {
+        stack.insert(stack.end(), chunk.stack.begin(), chunk.stack.end());
+      } else if (offset >= chunk.end) {
+        // The previous chunk's last token swallowed this chunk whole.
+        chunk.tokens.clear();
+        chunk.stop = offset;
+        chunk.stopPosition = position;
+      } else {
+        tokenizeChunk(&chunk, offset, position, stack);
+        stack = chunk.stack;
+      }
+
+      offset = chunk.stop;
+      position = chunk.stopPosition;
+    }
+  }
+
+  void run(void (ParallelTokenizer::*method)(Chunk*))
+  {
+    threads::forEach(this, method, &chunks_, threads_);
+  }
+
+  const char* code_;
+  index_type n_;
+  index_type threads_;
+  std::vector<Chunk> chunks_;
+};
+
+} // namespace tokenizer
+
+// Tokenize 'code' using up to 'threads' threads. Without C++11 support,
+// the chunks are tokenized one after another on the calling thread.
+inline std::vector<tokens::Token> tokenizeParallel(
+  const char* code,
+  index_type n,
+  index_type threads,
+  index_type chunkSize = threads::DEFAULT_CHUNK_SIZE)
+{
+  tokenizer::ParallelTokenizer tokenizer(code, n, threads, chunkSize);
+  return tokenizer.tokenize();
+}
+
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_TOKENIZATION_PARALLEL_TOKENIZER_H */
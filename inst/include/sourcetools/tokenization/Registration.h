@@ -4,6 +4,10 @@
 #include <string>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
+
+#include <sourcetools/core/config.h>
+#include <sourcetools/core/macros.h>
 
 namespace sourcetools {
 namespace tokens {
@@ -11,7 +15,7 @@ namespace tokens {
 typedef unsigned int TokenType;
 
 // Simple, non-nestable types.
-#define SOURCE_TOOLS_REGISTER_SIMPLE_TYPE(__NAME__, __TYPE__)         \
+#define SOURCE_TOOLS_REGISTER_SIMPLE_TYPE(__NAME__, __TYPE__)           \
   static const TokenType __NAME__ = __TYPE__
 
 SOURCE_TOOLS_REGISTER_SIMPLE_TYPE(INVALID,    (1 << 31));
@@ -35,8 +39,8 @@ SOURCE_TOOLS_REGISTER_SIMPLE_TYPE(NUMBER,     (1 << 20));
 #define SOURCE_TOOLS_BRACKET_LEFT_MASK  (SOURCE_TOOLS_BRACKET_BIT | SOURCE_TOOLS_BRACKET_LEFT_BIT)
 #define SOURCE_TOOLS_BRACKET_RIGHT_MASK (SOURCE_TOOLS_BRACKET_BIT | SOURCE_TOOLS_BRACKET_RIGHT_BIT)
 
-#define SOURCE_TOOLS_REGISTER_BRACKET(__NAME__, __SIDE__, __INDEX__)  \
-  static const TokenType __NAME__ =                            \
+#define SOURCE_TOOLS_REGISTER_BRACKET(__NAME__, __SIDE__, __INDEX__)    \
+  static const TokenType __NAME__ =                                     \
     SOURCE_TOOLS_BRACKET_BIT | __SIDE__ | __INDEX__
 
 SOURCE_TOOLS_REGISTER_BRACKET(LPAREN,    SOURCE_TOOLS_BRACKET_LEFT_BIT, (1 << 0));
@@ -63,7 +67,7 @@ SOURCE_TOOLS_REGISTER_BRACKET(RDBRACKET, SOURCE_TOOLS_BRACKET_RIGHT_BIT, (1 << 3
   static const char* const                                              \
     OPERATOR_ ## __NAME__ ## _STRING = __STRING__
 
-#define SOURCE_TOOLS_REGISTER_UNARY_OPERATOR(__NAME__, __STRING__, __INDEX__)    \
+#define SOURCE_TOOLS_REGISTER_UNARY_OPERATOR(__NAME__, __STRING__, __INDEX__) \
   SOURCE_TOOLS_REGISTER_OPERATOR(__NAME__, __STRING__, SOURCE_TOOLS_OPERATOR_UNARY_BIT | __INDEX__)
 
 // See ?"Syntax" for details on R's operators.
@@ -74,40 +78,69 @@ SOURCE_TOOLS_REGISTER_BRACKET(RDBRACKET, SOURCE_TOOLS_BRACKET_RIGHT_BIT, (1 << 3
 //
 // Note that although brackets are operators we tokenize them separately,
 // since we need to later check for their paired complement.
-SOURCE_TOOLS_REGISTER_UNARY_OPERATOR(PLUS,          "+",    0);
-SOURCE_TOOLS_REGISTER_UNARY_OPERATOR(MINUS,         "-",    1);
-SOURCE_TOOLS_REGISTER_UNARY_OPERATOR(HELP,          "?",    2);
-SOURCE_TOOLS_REGISTER_UNARY_OPERATOR(NEGATION,      "!",    3);
-SOURCE_TOOLS_REGISTER_UNARY_OPERATOR(FORMULA,       "~",    4);
-
-SOURCE_TOOLS_REGISTER_OPERATOR(NAMESPACE_EXPORTS,   "::",   5);
-SOURCE_TOOLS_REGISTER_OPERATOR(NAMESPACE_ALL,       ":::",  6);
-SOURCE_TOOLS_REGISTER_OPERATOR(DOLLAR,              "$",    7);
-SOURCE_TOOLS_REGISTER_OPERATOR(AT,                  "@",    8);
-SOURCE_TOOLS_REGISTER_OPERATOR(HAT,                 "^",    9);
-SOURCE_TOOLS_REGISTER_OPERATOR(EXPONENTATION_STARS, "**",  10);
-SOURCE_TOOLS_REGISTER_OPERATOR(SEQUENCE,            ":",   11);
-SOURCE_TOOLS_REGISTER_OPERATOR(MULTIPLY,            "*",   12);
-SOURCE_TOOLS_REGISTER_OPERATOR(DIVIDE,              "/",   13);
-SOURCE_TOOLS_REGISTER_OPERATOR(LESS,                "<",   14);
-SOURCE_TOOLS_REGISTER_OPERATOR(LESS_OR_EQUAL,       "<=",  15);
-SOURCE_TOOLS_REGISTER_OPERATOR(GREATER,             ">",   16);
-SOURCE_TOOLS_REGISTER_OPERATOR(GREATER_OR_EQUAL,    ">=",  17);
-SOURCE_TOOLS_REGISTER_OPERATOR(EQUAL,               "==",  18);
-SOURCE_TOOLS_REGISTER_OPERATOR(NOT_EQUAL,           "!=",  19);
-SOURCE_TOOLS_REGISTER_OPERATOR(AND_VECTOR,          "&",   20);
-SOURCE_TOOLS_REGISTER_OPERATOR(AND_SCALAR,          "&&",  21);
-SOURCE_TOOLS_REGISTER_OPERATOR(OR_VECTOR,           "|",   22);
-SOURCE_TOOLS_REGISTER_OPERATOR(OR_SCALAR,           "||",  23);
-SOURCE_TOOLS_REGISTER_OPERATOR(ASSIGN_LEFT,         "<-",  24);
-SOURCE_TOOLS_REGISTER_OPERATOR(ASSIGN_LEFT_PARENT,  "<<-", 25);
-SOURCE_TOOLS_REGISTER_OPERATOR(ASSIGN_RIGHT,        "->",  26);
-SOURCE_TOOLS_REGISTER_OPERATOR(ASSIGN_RIGHT_PARENT, "->>", 27);
-SOURCE_TOOLS_REGISTER_OPERATOR(ASSIGN_LEFT_EQUALS,  "=",   28);
-SOURCE_TOOLS_REGISTER_OPERATOR(ASSIGN_LEFT_COLON,   ":=",  29);
-SOURCE_TOOLS_REGISTER_OPERATOR(USER,                "%%",  30);
-SOURCE_TOOLS_REGISTER_OPERATOR(PIPE,                "|>",  31);
-SOURCE_TOOLS_REGISTER_OPERATOR(PIPE_BIND,           ">=",  32);
+//
+// Operators are listed here once, and registered from this list.
+#define SOURCE_TOOLS_OPERATORS(X)                                             \
+  X(PLUS,                "+",   SOURCE_TOOLS_OPERATOR_UNARY_BIT |  0)         \
+  X(MINUS,               "-",   SOURCE_TOOLS_OPERATOR_UNARY_BIT |  1)         \
+  X(HELP,                "?",   SOURCE_TOOLS_OPERATOR_UNARY_BIT |  2)         \
+  X(NEGATION,            "!",   SOURCE_TOOLS_OPERATOR_UNARY_BIT |  3)         \
+  X(FORMULA,             "~",   SOURCE_TOOLS_OPERATOR_UNARY_BIT |  4)         \
+                                                                              \
+  X(NAMESPACE_EXPORTS,   "::",  5)                                            \
+  X(NAMESPACE_ALL,       ":::", 6)                                            \
+  X(DOLLAR,              "$",   7)                                            \
+  X(AT,                  "@",   8)                                            \
+  X(HAT,                 "^",   9)                                            \
+  X(EXPONENTATION_STARS, "**",  10)                                           \
+  X(SEQUENCE,            ":",   11)                                           \
+  X(MULTIPLY,            "*",   12)                                           \
+  X(DIVIDE,              "/",   13)                                           \
+  X(LESS,                "<",   14)                                           \
+  X(LESS_OR_EQUAL,       "<=",  15)                                           \
+  X(GREATER,             ">",   16)                                           \
+  X(GREATER_OR_EQUAL,    ">=",  17)                                           \
+  X(EQUAL,               "==",  18)                                           \
+  X(NOT_EQUAL,           "!=",  19)                                           \
+  X(AND_VECTOR,          "&",   20)                                           \
+  X(AND_SCALAR,          "&&",  21)                                           \
+  X(OR_VECTOR,           "|",   22)                                           \
+  X(OR_SCALAR,           "||",  23)                                           \
+  X(ASSIGN_LEFT,         "<-",  24)                                           \
+  X(ASSIGN_LEFT_PARENT,  "<<-", 25)                                           \
+  X(ASSIGN_RIGHT,        "->",  26)                                           \
+  X(ASSIGN_RIGHT_PARENT, "->>", 27)                                           \
+  X(ASSIGN_LEFT_EQUALS,  "=",   28)                                           \
+  X(ASSIGN_LEFT_COLON,   ":=",  29)                                           \
+  X(USER,                "%%",  30)                                           \
+  X(PIPE,                "|>",  31)                                           \
+  X(PIPE_BIND,           ">=",  32)
+
+#define SOURCE_TOOLS_OPERATOR_DEFINITION(__NAME__, __STRING__, __MASKS__) \
+  SOURCE_TOOLS_REGISTER_OPERATOR(__NAME__, __STRING__, __MASKS__);
+
+SOURCE_TOOLS_OPERATORS(SOURCE_TOOLS_OPERATOR_DEFINITION)
+
+#undef SOURCE_TOOLS_OPERATOR_DEFINITION
+
+// The tokens that are fully determined by a single character: each is
+// the only token that starts with its character. The tokenizer's
+// character class table is built from this list, so a token added here
+// (or removed) is dispatched on accordingly.
+#define SOURCE_TOOLS_SINGLE_CHARACTER_TOKENS(X)                         \
+  X('(', LPAREN)                                                        \
+  X(')', RPAREN)                                                        \
+  X('{', LBRACE)                                                        \
+  X('}', RBRACE)                                                        \
+  X('+', OPERATOR_PLUS)                                                 \
+  X('?', OPERATOR_HELP)                                                 \
+  X('~', OPERATOR_FORMULA)                                              \
+  X('$', OPERATOR_DOLLAR)                                               \
+  X('@', OPERATOR_AT)                                                   \
+  X('^', OPERATOR_HAT)                                                  \
+  X('/', OPERATOR_DIVIDE)                                               \
+  X(',', COMMA)                                                         \
+  X(';', SEMI)
 
 /* Keywords and symbols */
 #define SOURCE_TOOLS_KEYWORD_BIT               (1 << 17)
@@ -115,70 +148,211 @@ SOURCE_TOOLS_REGISTER_OPERATOR(PIPE_BIND,           ">=",  32);
 #define SOURCE_TOOLS_KEYWORD_MASK              SOURCE_TOOLS_KEYWORD_BIT
 #define SOURCE_TOOLS_KEYWORD_CONTROL_FLOW_MASK (SOURCE_TOOLS_KEYWORD_MASK | SOURCE_TOOLS_KEYWORD_CONTROL_FLOW_BIT)
 
-#define SOURCE_TOOLS_REGISTER_KEYWORD(__NAME__, __MASKS__)            \
-  static const TokenType KEYWORD_ ## __NAME__ =                \
-    __MASKS__ | SOURCE_TOOLS_KEYWORD_MASK
-
-#define SOURCE_TOOLS_REGISTER_CONTROL_FLOW_KEYWORD(__NAME__, __MASKS__) \
-  SOURCE_TOOLS_REGISTER_KEYWORD(__NAME__, __MASKS__ | SOURCE_TOOLS_KEYWORD_CONTROL_FLOW_MASK)
-
-// See '?Reserved' for a list of reversed R symbols.
-SOURCE_TOOLS_REGISTER_CONTROL_FLOW_KEYWORD(IF,       1);
-SOURCE_TOOLS_REGISTER_CONTROL_FLOW_KEYWORD(FOR,      2);
-SOURCE_TOOLS_REGISTER_CONTROL_FLOW_KEYWORD(WHILE,    3);
-SOURCE_TOOLS_REGISTER_CONTROL_FLOW_KEYWORD(REPEAT,   4);
-SOURCE_TOOLS_REGISTER_CONTROL_FLOW_KEYWORD(FUNCTION, 5);
-
-SOURCE_TOOLS_REGISTER_KEYWORD(ELSE,                  6);
-SOURCE_TOOLS_REGISTER_KEYWORD(IN,                    7);
-SOURCE_TOOLS_REGISTER_KEYWORD(NEXT,                  8);
-SOURCE_TOOLS_REGISTER_KEYWORD(BREAK,                 9);
-SOURCE_TOOLS_REGISTER_KEYWORD(TRUE,                 10);
-SOURCE_TOOLS_REGISTER_KEYWORD(FALSE,                11);
-SOURCE_TOOLS_REGISTER_KEYWORD(NULL,                 12);
-SOURCE_TOOLS_REGISTER_KEYWORD(Inf,                  13);
-SOURCE_TOOLS_REGISTER_KEYWORD(NaN,                  14);
-SOURCE_TOOLS_REGISTER_KEYWORD(NA,                   15);
-SOURCE_TOOLS_REGISTER_KEYWORD(NA_integer_,          16);
-SOURCE_TOOLS_REGISTER_KEYWORD(NA_real_,             17);
-SOURCE_TOOLS_REGISTER_KEYWORD(NA_complex_,          18);
-SOURCE_TOOLS_REGISTER_KEYWORD(NA_character_,        19);
+#define SOURCE_TOOLS_REGISTER_KEYWORD(__NAME__, __STRING__, __MASKS__)  \
+                                                                        \
+  static const TokenType KEYWORD_ ## __NAME__ =                         \
+    __MASKS__ | SOURCE_TOOLS_KEYWORD_MASK;                              \
+                                                                        \
+  static const char* const                                              \
+    KEYWORD_ ## __NAME__ ## _STRING = __STRING__;
 
-inline TokenType symbolType(const char* string, index_type n)
+// See '?Reserved' for a list of reversed R symbols. Keywords are listed
+// here once, and registered (and entered in the keyword table used by
+// 'symbolType()') from this list.
+#define SOURCE_TOOLS_KEYWORDS(X)                                                 \
+  X(IF,            "if",             1 | SOURCE_TOOLS_KEYWORD_CONTROL_FLOW_MASK) \
+  X(FOR,           "for",            2 | SOURCE_TOOLS_KEYWORD_CONTROL_FLOW_MASK) \
+  X(WHILE,         "while",          3 | SOURCE_TOOLS_KEYWORD_CONTROL_FLOW_MASK) \
+  X(REPEAT,        "repeat",         4 | SOURCE_TOOLS_KEYWORD_CONTROL_FLOW_MASK) \
+  X(FUNCTION,      "function",       5 | SOURCE_TOOLS_KEYWORD_CONTROL_FLOW_MASK) \
+                                                                                 \
+  X(ELSE,          "else",           6)                                          \
+  X(IN,            "in",             7)                                          \
+  X(NEXT,          "next",           8)                                          \
+  X(BREAK,         "break",          9)                                          \
+  X(TRUE,          "TRUE",          10)                                          \
+  X(FALSE,         "FALSE",         11)                                          \
+  X(NULL,          "NULL",          12)                                          \
+  X(Inf,           "Inf",           13)                                          \
+  X(NaN,           "NaN",           14)                                          \
+  X(NA,            "NA",            15)                                          \
+  X(NA_integer_,   "NA_integer_",   16)                                          \
+  X(NA_real_,      "NA_real_",      17)                                          \
+  X(NA_complex_,   "NA_complex_",   18)                                          \
+  X(NA_character_, "NA_character_", 19)
+
+SOURCE_TOOLS_KEYWORDS(SOURCE_TOOLS_REGISTER_KEYWORD)
+
+namespace detail {
+
+struct Keyword
 {
-  // TODO: Is this insanity really an optimization or am I just silly?
-  if (n < 2 || n > 13) {
-    return SYMBOL;
-  } else if (n == 2) {
-    if (!std::memcmp(string, "in", n)) return KEYWORD_IN;
-    if (!std::memcmp(string, "if", n)) return KEYWORD_IF;
-    if (!std::memcmp(string, "NA", n)) return KEYWORD_NA;
-  } else if (n == 3) {
-    if (!std::memcmp(string, "for", n)) return KEYWORD_FOR;
-    if (!std::memcmp(string, "Inf", n)) return KEYWORD_Inf;
-    if (!std::memcmp(string, "NaN", n)) return KEYWORD_NaN;
-  } else if (n == 4) {
-    if (!std::memcmp(string, "else", n)) return KEYWORD_ELSE;
-    if (!std::memcmp(string, "next", n)) return KEYWORD_NEXT;
-    if (!std::memcmp(string, "TRUE", n)) return KEYWORD_TRUE;
-    if (!std::memcmp(string, "NULL", n)) return KEYWORD_NULL;
-  } else if (n == 5) {
-    if (!std::memcmp(string, "while", n)) return KEYWORD_WHILE;
-    if (!std::memcmp(string, "break", n)) return KEYWORD_BREAK;
-    if (!std::memcmp(string, "FALSE", n)) return KEYWORD_FALSE;
-  } else if (n == 6) {
-    if (!std::memcmp(string, "repeat", n)) return KEYWORD_REPEAT;
-  } else if (n == 8) {
-    if (!std::memcmp(string, "function", n)) return KEYWORD_FUNCTION;
-    if (!std::memcmp(string, "NA_real_", n)) return KEYWORD_NA_real_;
-  } else if (n == 11) {
-    if (!std::memcmp(string, "NA_integer_", n)) return KEYWORD_NA_integer_;
-    if (!std::memcmp(string, "NA_complex_", n)) return KEYWORD_NA_complex_;
-  } else if (n == 13) {
-    if (!std::memcmp(string, "NA_character_", n)) return KEYWORD_NA_character_;
+  const char* string;
+  index_type size;
+  TokenType type;
+};
+
+#define SOURCE_TOOLS_KEYWORD_ENTRY(__NAME__, __STRING__, __MASKS__)     \
+  { __STRING__, sizeof(__STRING__) - 1, KEYWORD_ ## __NAME__ },
+
+static const Keyword KEYWORDS[] = {
+  SOURCE_TOOLS_KEYWORDS(SOURCE_TOOLS_KEYWORD_ENTRY)
+};
+
+#undef SOURCE_TOOLS_KEYWORD_ENTRY
+
+static const index_type KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+
+// A perfect hash table over the keywords: every keyword hashes to its own
+// slot, so classifying a symbol costs one hash and one comparison. Before
+// hashing, we check a table of the keyword lengths seen for each first
+// byte, which turns away most ordinary symbols with a single load.
+//
+// The hash packs a symbol's length and its first, middle and last bytes
+// into a word (which, for symbols shorter than four bytes, is the whole
+// symbol), and keeps the top bits of its product with 'MULTIPLIER'. Longer
+// symbols are compared as four overlapping 32-bit words, rather than byte
+// by byte.
+//
+// 'MULTIPLIER' is the first odd multiplier up from 2^32 / phi under which
+// no two keywords collide; the unit tests repeat that search, so that
+// adding a keyword which breaks the table fails them (and names the
+// multiplier to use instead).
+class KeywordTable
+{
+public:
+  static const index_type BITS = 6;
+  static const index_type SIZE = 1 << BITS;
+
+  static const unsigned int MULTIPLIER = 0x9E377A13u;
+
+  // Symbols up to this length are compared word by word.
+  static const index_type WORD_COMPARE_SIZE = 16;
+
+  // Keywords must be shorter than this (the lengths for each first byte
+  // are kept as bits in a word).
+  static const index_type MAX_SIZE = 32;
+
+  explicit KeywordTable(unsigned int multiplier = MULTIPLIER)
+    : multiplier_(multiplier),
+      perfect_(true)
+  {
+    std::fill(sizes_, sizes_ + 256, 0u);
+    std::fill(slots_, slots_ + SIZE, static_cast<const Keyword*>(NULL));
+
+    for (index_type i = 0; i < KEYWORD_COUNT; ++i)
+    {
+      const Keyword* pKeyword = &KEYWORDS[i];
+      const char* string = pKeyword->string;
+      index_type n = pKeyword->size;
+
+      sizes_[static_cast<unsigned char>(string[0])] |= 1u << n;
+
+      unsigned int key = pack(string, n);
+      index_type slot = (key * multiplier_) >> (32 - BITS);
+      if (slots_[slot] != NULL)
+      {
+        perfect_ = false;
+        continue;
+      }
+
+      slots_[slot] = pKeyword;
+      keys_[slot] = key;
+      if (n >= 4 && n <= WORD_COMPARE_SIZE)
+      {
+        index_type step = (n - 4) / 3;
+        words_[slot][0] = load(string);
+        words_[slot][1] = load(string + step);
+        words_[slot][2] = load(string + 2 * step);
+        words_[slot][3] = load(string + n - 4);
+      }
+    }
   }
 
-  return SYMBOL;
+  // Whether no two keywords collide under the multiplier (a keyword that
+  // did collide is classified as a symbol).
+  bool perfect() const { return perfect_; }
+
+  TokenType lookup(const char* string, index_type n) const
+  {
+    if (n <= 0 || n >= MAX_SIZE)
+      return SYMBOL;
+
+    unsigned char first = string[0];
+    if ((sizes_[first] & (1u << n)) == 0)
+      return SYMBOL;
+
+    unsigned int key = pack(string, n);
+    index_type slot = (key * multiplier_) >> (32 - BITS);
+    const Keyword* pKeyword = slots_[slot];
+    if (pKeyword == NULL || keys_[slot] != key)
+      return SYMBOL;
+
+    if (n < 4)
+      return pKeyword->type;
+
+    if (n > WORD_COMPARE_SIZE)
+      return std::memcmp(pKeyword->string, string, n) ? SYMBOL : pKeyword->type;
+
+    // Compare words at offsets 0, k, 2k and n - 4 (k = (n - 4) / 3); for
+    // n <= 16 these cover every byte.
+    index_type step = (n - 4) / 3;
+    const unsigned int* words = words_[slot];
+    unsigned int difference =
+      (load(string) ^ words[0]) |
+      (load(string + step) ^ words[1]) |
+      (load(string + 2 * step) ^ words[2]) |
+      (load(string + n - 4) ^ words[3]);
+
+    return difference ? SYMBOL : pKeyword->type;
+  }
+
+private:
+
+  static unsigned int pack(const char* string, index_type n)
+  {
+    return
+      static_cast<unsigned char>(string[0]) |
+      static_cast<unsigned char>(string[n / 2]) << 8 |
+      static_cast<unsigned char>(string[n - 1]) << 16 |
+      static_cast<unsigned int>(n) << 24;
+  }
+
+  static unsigned int load(const char* string)
+  {
+    unsigned int word;
+    std::memcpy(&word, string, sizeof(word));
+    return word;
+  }
+
+  unsigned int multiplier_;
+  bool perfect_;
+  unsigned int sizes_[256];
+  const Keyword* slots_[SIZE];
+  unsigned int keys_[SIZE];
+  unsigned int words_[SIZE][4];
+};
+
+// The table is built on first use, and is never modified afterwards.
+// Tokenizers fetch it once, when they're constructed, rather than for
+// each symbol.
+//
+// Only C++11 makes the first use of a function-local static safe from
+// several threads at once. The library itself starts threads only in
+// C++11 builds (see 'ParallelTokenizer' and 'ParallelParser'); a C++98
+// program that tokenizes from threads of its own should classify one
+// symbol (e.g. 'symbolType("x")') before starting them.
+inline const KeywordTable& keywordTable()
+{
+  static const KeywordTable table;
+  return table;
+}
+
+} // namespace detail
+
+inline TokenType symbolType(const char* string, index_type n)
+{
+  return detail::keywordTable().lookup(string, n);
 }
 
 inline TokenType symbolType(const std::string& symbol)
@@ -0,0 +1,240 @@
+#ifndef SOURCETOOLS_TOKENIZATION_STREAMING_TOKENIZER_H
+#define SOURCETOOLS_TOKENIZATION_STREAMING_TOKENIZER_H
+
+#include <string>
+#include <vector>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/simd/simd.h>
+#include <sourcetools/collection/Position.h>
+#include <sourcetools/tokenization/Token.h>
+#include <sourcetools/tokenization/Tokenizer.h>
+
+namespace sourcetools {
+namespace tokenizer {
+
+// Tokenizes a document that arrives piece by piece (e.g. from a pipe or a
+// socket), passing each token to a sink as soon as it is known to be
+// complete.
+//
+// The tokenizer looks at most two bytes past the end of a token when
+// deciding where it ends, so a token is complete once two more bytes have
+// arrived after it. Everything from the first incomplete token onwards is
+// held back (as the 'pending' text) and tokenized again when more input
+// arrives; only that tail is ever kept in memory.
+//
+// A long string (or quoted symbol, user operator, comment or raw string)
+// can stay incomplete across many pieces of input. While it does, we only
+// search what arrives for its closing character, continuing from where the
+// last search stopped, and tokenize it again once that might have arrived.
+//
+// Tokens passed to a sink carry their offset and position within the
+// whole stream, but their text is only valid during the call.
+class StreamingTokenizer
+{
+private:
+  typedef tokens::Token Token;
+  typedef tokens::TokenType TokenType;
+  typedef collections::Position Position;
+
+public:
+
+  // Everything needed to resume tokenization later: where the pending
+  // text starts, the '[' / '[[' brackets open there, and the text itself.
+  // If the pending text starts with a token waiting for its closing
+  // character, 'scanned' is how far it has been searched for it (else 0).
+  struct State
+  {
+    State()
+      : offset(0),
+        position(0, 0),
+        scanned(0)
+    {
+    }
+
+    index_type offset;
+    Position position;
+    std::vector<TokenType> stack;
+    std::string pending;
+    index_type scanned;
+  };
+
+  explicit StreamingTokenizer(bool trackPositions = true)
+    : trackPositions_(trackPositions)
+  {
+    if (!trackPositions_)
+      state_.position = Position(-1, -1);
+  }
+
+  explicit StreamingTokenizer(const State& state, bool trackPositions = true)
+    : state_(state),
+      trackPositions_(trackPositions)
+  {
+  }
+
+  const State& state() const { return state_; }
+
+  // Tokenize the next 'n' bytes of the stream, passing completed tokens to
+  // 'sink'.
+  template <typename Sink>
+  void feed(const char* data, index_type n, Sink& sink)
+  {
+    if (n == 0)
+      return;
+
+    // Tokenize directly from the caller's buffer when nothing is pending,
+    // so that the common case copies only the incomplete tail.
+    if (state_.pending.empty()) {
+      index_type consumed = consume(data, n, false, sink);
+      state_.pending.assign(data + consumed, n - consumed);
+    } else {
+      state_.pending.append(data, n);
+      if (state_.scanned > 0 && !closed())
+        return;
+
+      index_type consumed = consume(state_.pending.data(), state_.pending.size(), false, sink);
+      state_.pending.erase(0, consumed);
+    }
+
+    state_.scanned = opening();
+    if (state_.scanned > 0 && closed())
+      state_.scanned = 0;
+  }
+
+  // Mark the end of the stream, passing any remaining tokens to 'sink'.
+  template <typename Sink>
+  void finish(Sink& sink)
+  {
+    consume(state_.pending.data(), state_.pending.size(), true, sink);
+    state_.pending.clear();
+    state_.scanned = 0;
+  }
+
+private:
+
+  // If the pending text starts with a token that ends at a closing
+  // character, the offset at which to start searching for it (past the
+  // opening quote, '%' or '#', or a raw string's 'r"-('); otherwise 0.
+  index_type opening() const
+  {
+    const std::string& pending = state_.pending;
+    index_type n = utils::size(pending);
+    if (n == 0)
+      return 0;
+
+    switch (pending[0])
+    {
+    case '"':
+    case '\'':
+    case '`':
+    case '%':
+    case '#':
+      return 1;
+    case 'r':
+    case 'R':
+      break;
+    default:
+      return 0;
+    }
+
+    index_type i = 1;
+    if (i == n || (pending[i] != '"' && pending[i] != '\''))
+      return 0;
+
+    for (++i; i < n && pending[i] == '-'; ++i)
+    {
+    }
+
+    if (i == n || (pending[i] != '(' && pending[i] != '{' && pending[i] != '['))
+      return 0;
+
+    return i + 1;
+  }
+
+  // Continue searching the pending text for the character that closes the
+  // token it starts with, skipping escaped characters as the tokenizer
+  // does, and note how far we got. A raw string's closing delimiter ends
+  // with its quote, so we stop at any such quote (or at a nul byte, where
+  // the tokenizer gives up), and leave the rest to the tokenizer.
+  bool closed()
+  {
+    const std::string& pending = state_.pending;
+    char first = pending[0];
+    bool raw = first == 'r' || first == 'R';
+    bool escapes = first == '"' || first == '\'' || first == '`';
+    char ch = raw ? pending[1] : (first == '#' ? '\n' : first);
+
+    index_type n = utils::size(pending);
+    const char* begin = pending.data();
+    const char* end = begin + n;
+    index_type i = state_.scanned;
+    while (i < n)
+    {
+      const char* it = raw ?
+        simd::find(begin + i, end, ch, '\0') :
+        (escapes ? simd::find(begin + i, end, ch, '\\') : simd::find(begin + i, end, ch));
+
+      if (it == end)
+      {
+        i = n;
+        break;
+      }
+
+      if (*it != '\\')
+        return true;
+
+      i = (it - begin) + 2;
+    }
+
+    state_.scanned = i;
+    return false;
+  }
+
+  template <typename Sink>
+  index_type consume(const char* code, index_type n, bool final, Sink& sink)
+  {
+    Tokenizer tokenizer(code, n, 0, state_.position, state_.stack, trackPositions_);
+
+    Token token;
+    index_type consumed = 0;
+    while (tokenizer.tokenize(&token))
+    {
+      index_type end = token.offset() + token.size();
+      if (!final && end + 2 > n)
+        break;
+
+      // Mirror the tokenizer's handling of '[', '[[' and ']'.
+      if (token.isType(tokens::LBRACKET) || token.isType(tokens::LDBRACKET))
+        state_.stack.push_back(token.type());
+      else if (*token.begin() == ']' && !state_.stack.empty())
+        state_.stack.pop_back();
+
+      consumed = end;
+      state_.position = tokenizer.position();
+
+      if (!Sink::INCLUDE_WHITESPACE && token.isType(tokens::WHITESPACE))
+        continue;
+
+      if (!Sink::INCLUDE_COMMENTS && token.isType(tokens::COMMENT))
+        continue;
+
+      sink(Token(token.begin(),
+                 token.end(),
+                 state_.offset + token.offset(),
+                 token.position(),
+                 token.type(),
+                 token.newlines()));
+    }
+
+    state_.offset += consumed;
+    return consumed;
+  }
+
+  State state_;
+  bool trackPositions_;
+};
+
+} // namespace tokenizer
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_TOKENIZATION_STREAMING_TOKENIZER_H */
@@ -9,8 +9,11 @@
 #include <sstream>
 
 #include <sourcetools/core/core.h>
+#include <sourcetools/simd/simd.h>
 #include <sourcetools/tokenization/Registration.h>
 #include <sourcetools/collection/Position.h>
+#include <sourcetools/collection/LineIndex.h>
+#include <sourcetools/collection/SymbolTable.h>
 #include <sourcetools/cursor/TextCursor.h>
 
 namespace sourcetools {
@@ -21,53 +24,80 @@ class Token
 private:
   typedef cursors::TextCursor TextCursor;
   typedef collections::Position Position;
+  typedef collections::LineIndex LineIndex;
+  typedef collections::SymbolId SymbolId;
 
 public:
 
   Token()
     : begin_(NULL),
-      end_(NULL),
+      size_(0),
       offset_(-1),
       position_(-1, -1),
-      type_(INVALID)
+      type_(INVALID),
+      data_(0)
   {
   }
 
   explicit Token(TokenType type)
     : begin_(NULL),
-      end_(NULL),
+      size_(0),
       offset_(-1),
       position_(-1, -1),
-      type_(type)
+      type_(type),
+      data_(0)
   {
+    if (type == SYMBOL)
+      data_ = collections::NO_SYMBOL;
   }
 
   Token(const Position& position)
     : begin_(NULL),
-      end_(NULL),
+      size_(0),
       offset_(-1),
       position_(position),
-      type_(INVALID)
+      type_(INVALID),
+      data_(0)
   {
   }
 
+  Token(const char* begin,
+        const char* end,
+        index_type offset,
+        const Position& position,
+        TokenType type,
+        index_type newlines = 0)
+    : begin_(begin),
+      size_(end - begin),
+      offset_(offset),
+      position_(position),
+      type_(type),
+      data_(newlines)
+  {
+    if (type == SYMBOL)
+      data_ = collections::NO_SYMBOL;
+  }
+
   Token(const TextCursor& cursor, TokenType type, index_type length)
     : begin_(cursor.begin() + cursor.offset()),
-      end_(cursor.begin() + cursor.offset() + length),
+      size_(length),
       offset_(cursor.offset()),
       position_(cursor.position()),
-      type_(type)
+      type_(type),
+      data_(0)
   {
+    if (type == SYMBOL)
+      data_ = collections::NO_SYMBOL;
   }
 
   const char* begin() const { return begin_; }
-  const char* end() const { return end_; }
+  const char* end() const { return begin_ + size_; }
   index_type offset() const { return offset_; }
-  index_type size() const { return end_ - begin_; }
+  index_type size() const { return size_; }
 
   std::string contents() const
   {
-    return std::string(begin_, end_);
+    return std::string(begin_, size_);
   }
 
   bool contentsEqual(const char* string)
@@ -87,16 +117,86 @@ public:
   index_type row() const { return position_.row; }
   index_type column() const { return position_.column; }
 
+  // Tokens produced without position tracking only know their offset;
+  // these overloads resolve their position through a line index.
+  bool hasPosition() const { return position_.row != -1; }
+
+  Position position(const LineIndex& index) const
+  {
+    if (hasPosition() || offset_ == -1)
+      return position_;
+    return index.position(offset_);
+  }
+
+  index_type row(const LineIndex& index) const
+  {
+    return position(index).row;
+  }
+
+  index_type column(const LineIndex& index) const
+  {
+    return position(index).column;
+  }
+
+  // The number of newlines within the token (e.g. a multi-line string),
+  // and so the row the token ends on. The tokenizer records these as it
+  // steps over the token, when it tracks positions (a token buffer
+  // recovers them through its line index); otherwise, they're 0 for all
+  // but symbols.
+  index_type newlines() const
+  {
+    if (LIKELY(type_ != SYMBOL))
+      return static_cast<index_type>(data_);
+
+    // Only a backticked name can span lines; these are rare, and short,
+    // so we count their newlines when asked.
+    if (size_ == 0 || *begin_ != '`')
+      return 0;
+    return simd::count(begin_, begin_ + size_, '\n');
+  }
+
+  index_type endRow() const { return position_.row + newlines(); }
+
+  void setNewlines(index_type newlines)
+  {
+    if (type_ != SYMBOL)
+      data_ = newlines;
+  }
+
   TokenType type() const { return type_; }
   bool isType(TokenType type) const { return type_ == type; }
 
+  // The id of a symbol token's name, when the tokenizer was given a
+  // symbol table to intern names into; NO_SYMBOL otherwise.
+  SymbolId symbol() const
+  {
+    return type_ == SYMBOL ? data_ : collections::NO_SYMBOL;
+  }
+
+  void setSymbol(SymbolId symbol) { data_ = symbol; }
+
+  // Point the token at the same text, after it has been moved to 'offset'
+  // within 'code' (and 'position'), e.g. by an edit before it.
+  void move(const char* code, index_type offset, const Position& position)
+  {
+    begin_ = code + offset;
+    offset_ = offset;
+    position_ = position;
+  }
+
 private:
   const char* begin_;
-  const char* end_;
+  index_type size_;
   index_type offset_;
 
   Position position_;
   TokenType type_;
+
+  // For a symbol, the id of its name; for any other token, the number of
+  // newlines it contains. Sharing the field keeps a token at 32 bytes.
+  // (It is a plain field rather than a union: with a union, GCC no longer
+  // keeps tokens in registers, which costs ~20% on the tokenization loop.)
+  unsigned int data_;
 };
 
 inline bool isBracket(const Token& token)
@@ -383,16 +483,23 @@ inline bool parseUnicode(const char*& it, char*& output)
 
 } // namespace detail
 
-inline std::string stringValue(const char* begin, const char* end)
+// Returns the value of the text in [begin, end) with escapes (if any)
+// decoded. Text without escapes is returned as-is, as a view of the
+// source; otherwise, the value is decoded into 'pBuffer', and the view
+// remains valid until the buffer is next modified.
+inline StringView stringValue(const char* begin,
+                              const char* end,
+                              std::string* pBuffer)
 {
-  if (begin == end)
-    return std::string();
-
-  index_type n = end - begin;
-  scoped_array<char> buffer(new char[n + 1]);
+  const char* it = simd::find(begin, end, '\\');
+  if (it == end)
+    return StringView(begin, end - begin);
 
-  const char* it = begin;
-  char* output = buffer;
+  // Escapes never decode to more bytes than they're written with.
+  pBuffer->resize(end - begin);
+  char* output = &(*pBuffer)[0];
+  std::memcpy(output, begin, it - begin);
+  output += it - begin;
 
   while (it < end)
   {
@@ -427,28 +534,39 @@ inline std::string stringValue(const char* begin, const char* end)
     }
   }
 
-  // Ensure null termination, just in case
-  *output++ = '\0';
-
-  // Construct the result string and return
-  std::string result(buffer, output - buffer);
-  return result;
+  const char* data = pBuffer->data();
+  return StringView(data, output - data);
 }
 
-inline std::string stringValue(const Token& token)
+// Returns the value of a string or symbol token: the text within its
+// quotes (or backticks), with escapes decoded. See above for how the
+// result refers to either the token's text or 'pBuffer'.
+inline StringView stringValue(const Token& token, std::string* pBuffer)
 {
   switch (token.type())
   {
   case STRING:
-    return stringValue(token.begin() + 1, token.end() - 1);
+    return stringValue(token.begin() + 1, token.end() - 1, pBuffer);
   case SYMBOL:
     if (*token.begin() == '`')
-      return stringValue(token.begin() + 1, token.end() - 1);
+      return stringValue(token.begin() + 1, token.end() - 1, pBuffer);
   default:
-    return stringValue(token.begin(), token.end());
+    return stringValue(token.begin(), token.end(), pBuffer);
   }
 }
 
+inline std::string stringValue(const char* begin, const char* end)
+{
+  std::string buffer;
+  return stringValue(begin, end, &buffer).str();
+}
+
+inline std::string stringValue(const Token& token)
+{
+  std::string buffer;
+  return stringValue(token, &buffer).str();
+}
+
 } // namespace tokens
 
 inline std::string toString(tokens::TokenType type)
@@ -0,0 +1,146 @@
+#ifndef SOURCETOOLS_TOKENIZATION_TOKEN_BUFFER_H
+#define SOURCETOOLS_TOKENIZATION_TOKEN_BUFFER_H
+
+#include <algorithm>
+#include <vector>
+
+#include <sourcetools/core/core.h>
+#include <sourcetools/collection/Position.h>
+#include <sourcetools/collection/LineIndex.h>
+#include <sourcetools/tokenization/Registration.h>
+#include <sourcetools/tokenization/Token.h>
+#include <sourcetools/tokenization/Numeric.h>
+#include <sourcetools/tokenization/Tokenizer.h>
+
+namespace sourcetools {
+namespace tokens {
+
+// Every registered token type has exactly one 'category' bit set in bits
+// 17-31, with any remaining bits in the low byte. This lets us pack a
+// token type into 16 bits, as (category index << 8) | (low byte).
+typedef unsigned short CompactTokenType;
+
+inline CompactTokenType compact(TokenType type)
+{
+  unsigned int category = 0;
+  for (TokenType bits = type >> 17; bits > 1; bits >>= 1)
+    ++category;
+  return static_cast<CompactTokenType>((category << 8) | (type & 0xFF));
+}
+
+inline TokenType expand(CompactTokenType code)
+{
+  return (1u << ((code >> 8) + 17)) | (code & 0xFF);
+}
+
+// A columnar store for the tokens of a document. Rather than keeping a
+// full 'Token' (two pointers, an offset, a position and a type) for each
+// token, we keep parallel arrays of 32-bit offsets, 32-bit lengths and
+// 16-bit type codes, plus a line index used to recover positions.
+//
+// Indexing a buffer materializes a 'Token' by value; prefer the columnar
+// accessors ('type()', 'offset()', 'size()') for scans over many tokens.
+//
+// Numeric literals are decoded as they're added, into a side table keyed
+// by token index (see 'numericValue()').
+class TokenBuffer : public tokenizer::TokenSink
+{
+public:
+  typedef Token value_type;
+  typedef Token const_reference;
+  typedef collections::Position Position;
+  typedef collections::LineIndex LineIndex;
+
+  // Positions are recovered through the line index.
+  static const bool TRACK_POSITIONS = false;
+
+  TokenBuffer()
+    : text_(NULL)
+  {
+  }
+
+  TokenBuffer(const char* text, index_type n)
+    : text_(text),
+      index_(text, n)
+  {
+  }
+
+  void push_back(const Token& token)
+  {
+    if (token.isType(NUMBER))
+    {
+      numberIndices_.push_back(size());
+      numbers_.push_back(tokens::numericValue(token));
+    }
+
+    offsets_.push_back(static_cast<unsigned int>(token.offset()));
+    lengths_.push_back(static_cast<unsigned int>(token.size()));
+    types_.push_back(compact(token.type()));
+  }
+
+  void operator()(const Token& token)
+  {
+    push_back(token);
+  }
+
+  void reserve(index_type n)
+  {
+    offsets_.reserve(n);
+    lengths_.reserve(n);
+    types_.reserve(n);
+  }
+
+  index_type size() const { return offsets_.size(); }
+  bool empty() const { return offsets_.empty(); }
+
+  TokenType type(index_type i) const { return expand(types_[i]); }
+  index_type offset(index_type i) const { return offsets_[i]; }
+  index_type size(index_type i) const { return lengths_[i]; }
+  const char* begin(index_type i) const { return text_ + offsets_[i]; }
+  const char* end(index_type i) const { return begin(i) + lengths_[i]; }
+  Position position(index_type i) const { return index_.position(offsets_[i]); }
+
+  Position position(index_type i, collections::ColumnUnit unit) const
+  {
+    return index_.position(offsets_[i], unit);
+  }
+
+  Token operator[](index_type i) const
+  {
+    Position start = position(i);
+    index_type newlines = index_.row(offsets_[i] + lengths_[i]) - start.row;
+    return Token(begin(i), end(i), offset(i), start, type(i), newlines);
+  }
+
+  // The decoded value of the token at 'i', which must be a NUMBER token.
+  const NumericValue& numericValue(index_type i) const
+  {
+    std::vector<index_type>::const_iterator it =
+      std::lower_bound(numberIndices_.begin(), numberIndices_.end(), i);
+    return numbers_[it - numberIndices_.begin()];
+  }
+
+  const char* text() const { return text_; }
+  const LineIndex& lineIndex() const { return index_; }
+
+private:
+  const char* text_;
+  LineIndex index_;
+  std::vector<unsigned int> offsets_;
+  std::vector<unsigned int> lengths_;
+  std::vector<CompactTokenType> types_;
+  std::vector<index_type> numberIndices_;
+  std::vector<NumericValue> numbers_;
+};
+
+} // namespace tokens
+
+inline void tokenize(const char* code, index_type n, tokens::TokenBuffer* pBuffer)
+{
+  *pBuffer = tokens::TokenBuffer(code, n);
+  tokenize(code, n, *pBuffer);
+}
+
+} // namespace sourcetools
+
+#endif /* SOURCETOOLS_TOKENIZATION_TOKEN_BUFFER_H */
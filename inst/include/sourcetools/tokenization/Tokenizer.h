@@ -2,17 +2,33 @@
 #define SOURCETOOLS_TOKENIZATION_TOKENIZER_H
 
 #include <sourcetools/core/core.h>
+#include <sourcetools/simd/simd.h>
 #include <sourcetools/tokenization/Token.h>
+#include <sourcetools/tokenization/CharacterClass.h>
 #include <sourcetools/cursor/TextCursor.h>
+#include <sourcetools/collection/SymbolTable.h>
 
 #include <vector>
-#include <stack>
 #include <sstream>
 
 namespace sourcetools {
 namespace tokenizer {
 
-class Tokenizer
+// Tokenizer policies. 'AllTokens' produces every token, including
+// whitespace and comments; 'SignificantTokens' skips over whitespace and
+// comments without producing tokens for them (as the parser, for one,
+// has no use for them).
+template <bool SignificantOnly>
+struct TokenizerPolicy
+{
+  static const bool SIGNIFICANT_ONLY = SignificantOnly;
+};
+
+typedef TokenizerPolicy<false> AllTokens;
+typedef TokenizerPolicy<true>  SignificantTokens;
+
+template <typename Policy>
+class BasicTokenizer
 {
 private:
   typedef tokens::Token Token;
@@ -31,41 +47,49 @@ private:
     cursor_.advance(length);
   }
 
+  // As above, for tokens that may span lines (strings, comments, and
+  // whitespace). The cursor counts the newlines it steps over as it goes;
+  // we keep the count with the token, so that e.g. the parser needn't scan
+  // a long string again to learn which row it ends on.
+  void consumeMultilineToken(TokenType type,
+                             index_type length,
+                             Token* pToken)
+  {
+    index_type row = cursor_.row();
+    consumeToken(type, length, pToken);
+    pToken->setNewlines(cursor_.row() - row);
+  }
+
   template <bool SkipEscaped, bool InvalidOnError>
   void consumeUntil(char ch,
                     TokenType type,
                     Token* pToken)
   {
-    TextCursor lookahead = cursor_;
-
-    bool success = false;
-    index_type distance = 0;
-
-    while (lookahead != lookahead.end()) {
-      lookahead.advance();
-      ++distance;
+    const char* begin = cursor_;
+    const char* end = cursor_.end();
+
+    // Scan for the terminating character (and, if requested, for escape
+    // characters, which cause the following character to be skipped).
+    const char* it = begin + 1;
+    while (it < end) {
+      it = SkipEscaped ?
+        simd::find(it, end, ch, '\\') :
+        simd::find(it, end, ch);
+
+      if (it == end)
+        break;
 
-      if (SkipEscaped && lookahead.peek() == '\\') {
-        lookahead.advance();
-        ++distance;
-        continue;
-      }
+      if (*it == ch)
+        return consumeMultilineToken(type, it - begin + 1, pToken);
 
-      if (lookahead.peek() == ch) {
-        success = true;
-        break;
-      }
+      it += 2;
     }
 
-    if (success) {
-      consumeToken(type, distance + 1, pToken);
-    } else {
-      consumeToken(
-        InvalidOnError ? tokens::INVALID : type,
-        distance,
-        pToken
-      );
-    }
+    consumeMultilineToken(
+      InvalidOnError ? tokens::INVALID : type,
+      end - begin,
+      pToken
+    );
   }
 
   void consumeUserOperator(Token* pToken)
@@ -81,6 +105,15 @@ private:
   void consumeQuotedSymbol(Token* pToken)
   {
     consumeUntil<true, true>('`', tokens::SYMBOL, pToken);
+
+    if (!pSymbols_ || !pToken->isType(tokens::SYMBOL))
+      return;
+
+    // Intern the name within the backticks. Names with escapes are decoded
+    // into a local buffer, which is only allocated for those.
+    std::string buffer;
+    StringView name = tokens::stringValue(*pToken, &buffer);
+    pToken->setSymbol(pSymbols_->intern(name.begin(), name.size()));
   }
 
   void consumeQString(Token* pToken)
@@ -141,9 +174,9 @@ private:
       lhs = cursor.peek();
       break;
     default:
-      return consumeToken(tokens::INVALID,
-                          cursor.offset() - start + 1,
-                          pToken);
+      return consumeMultilineToken(tokens::INVALID,
+                                   cursor.offset() - start + 1,
+                                   pToken);
     }
     cursor.advance();
 
@@ -155,47 +188,50 @@ private:
     case '{': rhs = '}'; break;
     case '[': rhs = ']'; break;
     default:
-      return consumeToken(tokens::INVALID,
-                          cursor.offset() - start + 1,
-                          pToken);
+      return consumeMultilineToken(tokens::INVALID,
+                                   cursor.offset() - start + 1,
+                                   pToken);
     }
 
-    // start consuming things until we find the closing delimiter
-    for (; cursor.peek() != '\0'; cursor.advance())
+    // start consuming things until we find the closing delimiter. note
+    // that an embedded nul byte is treated as the end of input, and that
+    // a character which fails to complete the closing delimiter is
+    // skipped before searching for the next candidate
+    const char* begin = cursor_;
+    const char* end = cursor.end();
+    const char* it = cursor;
+    while (it < end)
     {
-      // check for right delimiter
-      if (cursor.peek() != rhs)
-        goto AGAIN;
-      cursor.advance();
+      // find the next candidate right delimiter
+      it = simd::find(it, end, rhs, '\0');
+      if (it == end || *it == '\0')
+        break;
+      ++it;
 
       // consume dashes
-      for (int i = 0; i < dashes; i++)
-      {
-        if (cursor.peek() != '-')
-          goto AGAIN;
-        cursor.advance();
-      }
+      int i = 0;
+      for (; i < dashes && it < end && *it == '-'; i++)
+        ++it;
 
       // check for matching quote
-      if (cursor.peek() != quote)
-        goto AGAIN;
-      cursor.advance();
-
-      // if we got this far, we successfully matched the raw string
-      return consumeToken(
-        tokens::STRING,
-        cursor.offset() - start,
-        pToken
-      );
+      if (i == dashes && it < end && *it == quote)
+      {
+        // if we got this far, we successfully matched the raw string
+        return consumeMultilineToken(
+          tokens::STRING,
+          it - begin + 1,
+          pToken
+        );
+      }
 
-      // if we got here, we need to restart the loop
-      AGAIN: ;
+      // if we got here, we need to restart the search
+      ++it;
     }
 
     // if we got here, we failed to match
-    return consumeToken(
+    return consumeMultilineToken(
       tokens::INVALID,
-      cursor.offset() - start,
+      (it < end ? it : end) - begin,
       pToken
     );
 
@@ -216,23 +252,6 @@ private:
     return ch == '\'' || ch == '"';
   }
 
-  // NOTE: Don't tokenize '-' or '+' as part of number; instead
-  // it's parsed as a unary operator.
-  bool isStartOfNumber()
-  {
-    char ch = cursor_.peek();
-    if (utils::isDigit(ch))
-      return true;
-    if (ch == '.')
-      return utils::isDigit(cursor_.peek(1));
-    return false;
-  }
-
-  bool isStartOfSymbol()
-  {
-    return utils::isValidForStartOfRSymbol(cursor_.peek());
-  }
-
   bool consumeHexadecimalNumber(Token* pToken)
   {
     index_type distance = 0;
@@ -255,7 +274,7 @@ private:
     if (!utils::isHexDigit(cursor_.peek(distance)))
     {
       consumeToken(tokens::INVALID, distance, pToken);
-      return false;
+      return true;
     }
 
     bool success = true;
@@ -343,26 +362,93 @@ private:
 
   void consumeSymbol(Token* pToken)
   {
-    index_type distance = 1;
-    char ch = cursor_.peek(distance);
-    while (utils::isValidForRSymbol(ch)) {
-      ++distance;
-      ch = cursor_.peek(distance);
+    const char* begin = cursor_;
+    const char* end = cursor_.end();
+    const char* it = begin + 1;
+    while (it < end && isValidForSymbol(*it))
+      ++it;
+
+    index_type distance = it - begin;
+    TokenType type = pKeywords_->lookup(begin, distance);
+    consumeToken(type, distance, pToken);
+
+    if (pSymbols_ && type == tokens::SYMBOL)
+      pToken->setSymbol(pSymbols_->intern(begin, distance));
+  }
+
+  void consumeWhitespace(Token* pToken)
+  {
+    const char* begin = cursor_;
+    const char* end = cursor_.end();
+    const char* it = begin + 1;
+    while (it < end && characterClass(*it) == CHARACTER_CLASS_WHITESPACE)
+      ++it;
+
+    consumeMultilineToken(tokens::WHITESPACE, it - begin, pToken);
+  }
+
+  // Skip whitespace and comments in one pass, advancing the cursor (and
+  // its position) once for the whole run.
+  void skipInsignificant()
+  {
+    const char* begin = cursor_;
+    const char* end = cursor_.end();
+    const char* it = begin;
+    while (it < end)
+    {
+      CharacterClass type = characterClass(*it);
+      if (type == CHARACTER_CLASS_WHITESPACE)
+        ++it;
+      else if (type == CHARACTER_CLASS_HASH)
+        it = simd::find(it + 1, end, '\n');
+      else
+        break;
     }
 
-    const char* ptr = &*(cursor_.begin() + cursor_.offset());
-    consumeToken(tokens::symbolType(ptr, distance), distance, pToken);
+    if (it != begin)
+      cursor_.advance(it - begin);
   }
 
 public:
 
-  Tokenizer(const char* code, index_type n)
-    : cursor_(code, n)
+  // When 'trackPositions' is false, tokens record only their byte offsets
+  // (their positions are left at (-1, -1)); use a 'collections::LineIndex'
+  // to resolve positions for the tokens that need them.
+  BasicTokenizer(const char* code, index_type n, bool trackPositions = true)
+    : cursor_(code, n, trackPositions),
+      pKeywords_(&tokens::detail::keywordTable()),
+      pSymbols_(NULL)
   {
   }
 
+  // Resume tokenization at 'offset' (which should lie on a token
+  // boundary), with the given position and stack of open '[' / '[['
+  // brackets.
+  BasicTokenizer(const char* code,
+            index_type n,
+            index_type offset,
+            const collections::Position& position,
+            const std::vector<TokenType>& stack,
+            bool trackPositions = true)
+    : cursor_(code, n, offset, position, trackPositions),
+      tokenStack_(stack),
+      pKeywords_(&tokens::detail::keywordTable()),
+      pSymbols_(NULL)
+  {
+  }
+
+  // Intern the names of symbol tokens into 'pSymbols' (see 'Token::symbol()').
+  void setSymbolTable(collections::SymbolTable* pSymbols) { pSymbols_ = pSymbols; }
+
+  index_type offset() const { return cursor_.offset(); }
+  const collections::Position& position() const { return cursor_.position(); }
+  const std::vector<TokenType>& stack() const { return tokenStack_; }
+
   bool tokenize(Token* pToken)
   {
+    if (Policy::SIGNIFICANT_ONLY)
+      skipInsignificant();
+
     if (cursor_ >= cursor_.end())
     {
       *pToken = Token(tokens::END);
@@ -370,42 +456,51 @@ public:
     }
 
     char ch = cursor_.peek();
-    int n = 0;
+    switch (characterClass(ch))
+    {
+
+    // Single-character tokens: brackets, some operators, punctuation
+    case CHARACTER_CLASS_SINGLE:
+      consumeToken(singleCharacterTokenType(ch), 1, pToken);
+      break;
+
+    // Symbols and whitespace; by far the most common tokens
+    case CHARACTER_CLASS_SYMBOL:
+      consumeSymbol(pToken);
+      break;
+
+    case CHARACTER_CLASS_WHITESPACE:
+      consumeWhitespace(pToken);
+      break;
 
     // Block-related tokens
-    if (ch == '{')
-      consumeToken(tokens::LBRACE, 1, pToken);
-    else if (ch == '}')
-      consumeToken(tokens::RBRACE, 1, pToken);
-    else if (ch == '(')
-      consumeToken(tokens::LPAREN, 1, pToken);
-    else if (ch == ')')
-      consumeToken(tokens::RPAREN, 1, pToken);
-    else if (ch == '[') {
+    case CHARACTER_CLASS_LBRACKET:
       if (cursor_.peek(1) == '[') {
-        tokenStack_.push(tokens::LDBRACKET);
+        tokenStack_.push_back(tokens::LDBRACKET);
         consumeToken(tokens::LDBRACKET, 2, pToken);
       } else {
-        tokenStack_.push(tokens::LBRACKET);
+        tokenStack_.push_back(tokens::LBRACKET);
         consumeToken(tokens::LBRACKET, 1, pToken);
       }
-    } else if (ch == ']') {
+      break;
+
+    case CHARACTER_CLASS_RBRACKET:
       if (tokenStack_.empty()) {
         consumeToken(tokens::INVALID, 1, pToken);
-      } else if (tokenStack_.top() == tokens::LDBRACKET) {
-        tokenStack_.pop();
+      } else if (tokenStack_.back() == tokens::LDBRACKET) {
+        tokenStack_.pop_back();
         if (cursor_.peek(1) == ']')
           consumeToken(tokens::RDBRACKET, 2, pToken);
         else
           consumeToken(tokens::INVALID, 1, pToken);
       } else {
-        tokenStack_.pop();
+        tokenStack_.pop_back();
         consumeToken(tokens::RBRACKET, 1, pToken);
       }
-    }
+      break;
 
     // Operators
-    else if (ch == '<')  // <<-, <=, <-, <
+    case CHARACTER_CLASS_LESS: // <<-, <=, <-, <
     {
       char next = cursor_.peek(1);
       if (next == '-') // <-
@@ -416,16 +511,17 @@ public:
         consumeToken(tokens::OPERATOR_ASSIGN_LEFT_PARENT, 3, pToken);
       else
         consumeToken(tokens::OPERATOR_LESS, 1, pToken);
+      break;
     }
 
-    else if (ch == '>')  // >=, >
-    {
+    case CHARACTER_CLASS_GREATER: // >=, >
       if (cursor_.peek(1) == '=')
         consumeToken(tokens::OPERATOR_GREATER_OR_EQUAL, 2, pToken);
       else
         consumeToken(tokens::OPERATOR_GREATER, 1, pToken);
-    }
-    else if (ch == '=')  // '==', '=>', '='
+      break;
+
+    case CHARACTER_CLASS_EQUAL: // '==', '=>', '='
     {
       char next = cursor_.peek(1);
       if (next == '>')
@@ -434,8 +530,10 @@ public:
         consumeToken(tokens::OPERATOR_EQUAL, 2, pToken);
       else
         consumeToken(tokens::OPERATOR_ASSIGN_LEFT_EQUALS, 1, pToken);
+      break;
     }
-    else if (ch == '|')  // '||', '|>', '|'
+
+    case CHARACTER_CLASS_PIPE: // '||', '|>', '|'
     {
       char next = cursor_.peek(1);
       if (next == '>')
@@ -444,23 +542,24 @@ public:
         consumeToken(tokens::OPERATOR_OR_SCALAR, 2, pToken);
       else
         consumeToken(tokens::OPERATOR_OR_VECTOR, 1, pToken);
+      break;
     }
-    else if (ch == '&')  // '&&', '&'
-    {
+
+    case CHARACTER_CLASS_AMPERSAND: // '&&', '&'
       if (cursor_.peek(1) == '&')
         consumeToken(tokens::OPERATOR_AND_SCALAR, 2, pToken);
       else
         consumeToken(tokens::OPERATOR_AND_VECTOR, 1, pToken);
-    }
-    else if (ch == '*')  // **, *
-    {
+      break;
+
+    case CHARACTER_CLASS_STAR: // **, *
       if (cursor_.peek(1) == '*')
         consumeToken(tokens::OPERATOR_EXPONENTATION_STARS, 2, pToken);
       else
         consumeToken(tokens::OPERATOR_MULTIPLY, 1, pToken);
-    }
-    else if (ch == ':')  // ':::', '::', ':=', ':'
-    {
+      break;
+
+    case CHARACTER_CLASS_COLON: // ':::', '::', ':=', ':'
       if (cursor_.peek(1) == ':')
       {
         if (cursor_.peek(2) == ':')
@@ -472,16 +571,16 @@ public:
         consumeToken(tokens::OPERATOR_ASSIGN_LEFT_COLON, 2, pToken);
       else
         consumeToken(tokens::OPERATOR_SEQUENCE, 1, pToken);
-    }
-    else if (ch == '!')
-    {
+      break;
+
+    case CHARACTER_CLASS_BANG: // '!=', '!'
       if (cursor_.peek(1) == '=')
         consumeToken(tokens::OPERATOR_NOT_EQUAL, 2, pToken);
       else
         consumeToken(tokens::OPERATOR_NEGATION, 1, pToken);
-    }
-    else if (ch == '-') // '->>', '->', '-'
-    {
+      break;
+
+    case CHARACTER_CLASS_MINUS: // '->>', '->', '-'
       if (cursor_.peek(1) == '>')
       {
         if (cursor_.peek(2) == '>')
@@ -491,68 +590,66 @@ public:
       }
       else
         consumeToken(tokens::OPERATOR_MINUS, 1, pToken);
-    }
-    else if (ch == '+')
-      consumeToken(tokens::OPERATOR_PLUS, 1, pToken);
-    else if (ch == '~')
-      consumeToken(tokens::OPERATOR_FORMULA, 1, pToken);
-    else if (ch == '?')
-      consumeToken(tokens::OPERATOR_HELP, 1, pToken);
-    else if (ch == '/')
-      consumeToken(tokens::OPERATOR_DIVIDE, 1, pToken);
-    else if (ch == '@')
-      consumeToken(tokens::OPERATOR_AT, 1, pToken);
-    else if (ch == '$')
-      consumeToken(tokens::OPERATOR_DOLLAR, 1, pToken);
-    else if (ch == '^')
-      consumeToken(tokens::OPERATOR_HAT, 1, pToken);
+      break;
 
     // User operators
-    else if (ch == '%')
+    case CHARACTER_CLASS_PERCENT:
       consumeUserOperator(pToken);
+      break;
 
-    // Punctuation-related tokens
-    else if (ch == ',')
-      consumeToken(tokens::COMMA, 1, pToken);
-    else if (ch == ';')
-      consumeToken(tokens::SEMI, 1, pToken);
-
-    // Whitespace
-    else if (utils::countWhitespaceBytes(cursor_, &n))
-      consumeToken(tokens::WHITESPACE, n, pToken);
-
-    // Strings and symbols
-    else if (ch == '\'')
+    // Strings and quoted symbols
+    case CHARACTER_CLASS_QUOTE:
       consumeQString(pToken);
-    else if (ch == '"')
+      break;
+
+    case CHARACTER_CLASS_DOUBLE_QUOTE:
       consumeQQString(pToken);
-    else if (ch == '`')
+      break;
+
+    case CHARACTER_CLASS_BACKTICK:
       consumeQuotedSymbol(pToken);
-    else if (isStartOfRawString(cursor_))
-      consumeRawString(pToken);
+      break;
 
     // Comments
-    else if (ch == '#')
+    case CHARACTER_CLASS_HASH:
       consumeComment(pToken);
+      break;
 
-    // Number
-    else if (isStartOfNumber())
+    // Numbers
+    case CHARACTER_CLASS_DIGIT:
       consumeNumber(pToken);
+      break;
 
-    // Symbol
-    else if (isStartOfSymbol())
-      consumeSymbol(pToken);
+    // Numbers ('.5') or symbols ('.x')
+    case CHARACTER_CLASS_DOT:
+      if (utils::isDigit(cursor_.peek(1)))
+        consumeNumber(pToken);
+      else
+        consumeSymbol(pToken);
+      break;
+
+    // Raw strings ('r"(...)"') or symbols
+    case CHARACTER_CLASS_RAW:
+      if (isStartOfRawString(cursor_))
+        consumeRawString(pToken);
+      else
+        consumeSymbol(pToken);
+      break;
 
     // Nothing matched -- error
-    else
+    case CHARACTER_CLASS_UNDERSCORE:
+    case CHARACTER_CLASS_INVALID:
       consumeToken(tokens::INVALID, 1, pToken);
+      break;
+
+    }
 
     return true;
   }
 
   Token peek(index_type lookahead = 1)
   {
-    Tokenizer clone(*this);
+    BasicTokenizer clone(*this);
 
     Token result(tokens::END);
     for (index_type i = 0; i < lookahead; ++i) {
@@ -566,12 +663,63 @@ public:
 
 private:
   TextCursor cursor_;
-  std::stack<TokenType, std::vector<TokenType> > tokenStack_;
+  std::vector<TokenType> tokenStack_;
+  const tokens::detail::KeywordTable* pKeywords_;
+  collections::SymbolTable* pSymbols_;
+};
+
+typedef BasicTokenizer<AllTokens>         Tokenizer;
+typedef BasicTokenizer<SignificantTokens> SignificantTokenizer;
+
+// Base class for token sinks; i.e. objects that receive tokens one at a
+// time through 'void operator()(const tokens::Token&)'. Sinks can hide
+// these flags to declare which tokens (and what information) they need:
+//
+//   INCLUDE_WHITESPACE: whether whitespace tokens are passed to the sink,
+//   INCLUDE_COMMENTS:   whether comment tokens are passed to the sink,
+//   TRACK_POSITIONS:    whether tokens should carry their row and column.
+struct TokenSink
+{
+  static const bool INCLUDE_WHITESPACE = true;
+  static const bool INCLUDE_COMMENTS   = true;
+  static const bool TRACK_POSITIONS    = true;
 };
 
 } // namespace tokenizer
 
-inline std::vector<tokens::Token> tokenize(const char* code, index_type n)
+// Tokenize 'code', passing each token to 'sink' as it is produced. Sinks
+// that want neither whitespace nor comments get a tokenizer that skips
+// over them without producing tokens.
+template <typename Sink>
+inline void tokenize(const char* code, index_type n, Sink& sink)
+{
+  typedef tokenizer::TokenizerPolicy<
+    !Sink::INCLUDE_WHITESPACE && !Sink::INCLUDE_COMMENTS
+  > Policy;
+
+  typedef tokenizer::BasicTokenizer<Policy> Tokenizer;
+  typedef tokens::Token Token;
+
+  if (n == 0)
+    return;
+
+  Token token;
+  Tokenizer tokenizer(code, n, Sink::TRACK_POSITIONS);
+  while (tokenizer.tokenize(&token))
+  {
+    if (!Sink::INCLUDE_WHITESPACE && token.isType(tokens::WHITESPACE))
+      continue;
+
+    if (!Sink::INCLUDE_COMMENTS && token.isType(tokens::COMMENT))
+      continue;
+
+    sink(token);
+  }
+}
+
+inline std::vector<tokens::Token> tokenize(const char* code,
+                                           index_type n,
+                                           bool trackPositions = true)
 {
   typedef tokenizer::Tokenizer Tokenizer;
   typedef tokens::Token Token;
@@ -581,16 +729,17 @@ inline std::vector<tokens::Token> tokenize(const char* code, index_type n)
     return tokens;
 
   Token token;
-  Tokenizer tokenizer(code, n);
+  Tokenizer tokenizer(code, n, trackPositions);
   while (tokenizer.tokenize(&token))
     tokens.push_back(token);
 
   return tokens;
 }
 
-inline std::vector<tokens::Token> tokenize(const std::string& code)
+inline std::vector<tokens::Token> tokenize(const std::string& code,
+                                           bool trackPositions = true)
 {
-  return tokenize(code.data(), code.size());
+  return tokenize(code.data(), code.size(), trackPositions);
 }
 
 } // namespace sourcetools
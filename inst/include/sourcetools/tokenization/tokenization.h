@@ -2,7 +2,14 @@
 #define SOURCETOOLS_TOKENIZATION_TOKENIZATION_H
 
 #include <sourcetools/tokenization/Registration.h>
+#include <sourcetools/tokenization/CharacterClass.h>
 #include <sourcetools/tokenization/Token.h>
 #include <sourcetools/tokenization/Tokenizer.h>
+#include <sourcetools/tokenization/Numeric.h>
+#include <sourcetools/tokenization/TokenBuffer.h>
+#include <sourcetools/tokenization/ParallelTokenizer.h>
+#include <sourcetools/tokenization/IncrementalTokenizer.h>
+#include <sourcetools/tokenization/StreamingTokenizer.h>
+#include <sourcetools/tokenization/BufferedTokenizer.h>
 
 #endif /* SOURCETOOLS_TOKENIZATION_TOKENIZATION_H */
@@ -2,8 +2,10 @@
 #define SOURCETOOLS_UTF8_UTF8_H
 
 #include <cstddef>
+#include <algorithm>
 
 #include <sourcetools/core/core.h>
+#include <sourcetools/simd/simd.h>
 
 namespace sourcetools {
 namespace utf8 {
@@ -109,6 +111,121 @@ private:
   index_type offset_;
 };
 
+// Returns the length of the well-formed UTF-8 sequence starting at 'it',
+// or 0 if the bytes there are malformed. Following RFC 3629, overlong
+// encodings, surrogates and code points past U+10FFFF are malformed.
+inline index_type sequenceLength(const char* it, const char* end)
+{
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(it);
+  index_type available = end - it;
+  if (available <= 0)
+    return 0;
+
+  unsigned char ch = data[0];
+  if (ch < 0x80)
+    return 1;
+
+  // The range allowed for the second byte depends on the first.
+  index_type n;
+  unsigned char lower = 0x80, upper = 0xBF;
+  if (ch >= 0xC2 && ch <= 0xDF) {
+    n = 2;
+  } else if (ch >= 0xE0 && ch <= 0xEF) {
+    n = 3;
+    if (ch == 0xE0) lower = 0xA0;
+    if (ch == 0xED) upper = 0x9F;
+  } else if (ch >= 0xF0 && ch <= 0xF4) {
+    n = 4;
+    if (ch == 0xF0) lower = 0x90;
+    if (ch == 0xF4) upper = 0x8F;
+  } else {
+    return 0;
+  }
+
+  if (available < n || data[1] < lower || data[1] > upper)
+    return 0;
+
+  for (index_type i = 2; i < n; ++i)
+    if ((data[i] & 0xC0) != 0x80)
+      return 0;
+
+  return n;
+}
+
+// Counts the code points in [begin, end), and the UTF-16 code units that
+// would encode them. Runs of ASCII are skipped with a vectorized scan.
+// Each byte of a malformed sequence counts as one code point (as if it
+// were replaced with U+FFFD). Returns the first malformed byte, or 'end'
+// if the text is well-formed.
+inline const char* count(const char* begin,
+                         const char* end,
+                         index_type* pCodePoints,
+                         index_type* pUnits)
+{
+  index_type codePoints = 0;
+  index_type units = 0;
+  const char* malformed = end;
+
+  const char* it = begin;
+  while (it < end)
+  {
+    const char* next = simd::findNonAscii(it, end);
+    codePoints += next - it;
+    units += next - it;
+    it = next;
+    if (it == end)
+      break;
+
+    index_type n = sequenceLength(it, end);
+    if (n == 0)
+    {
+      if (malformed == end)
+        malformed = it;
+      n = 1;
+    }
+
+    codePoints += 1;
+    units += n == 4 ? 2 : 1;
+    it += n;
+  }
+
+  *pCodePoints = codePoints;
+  *pUnits = units;
+  return malformed;
+}
+
+// Returns the start of the code point 'n' code points (or, if 'utf16' is
+// set, 'n' UTF-16 code units) past 'begin', stopping at 'end'. An 'n' that
+// falls within a surrogate pair gives the start of that code point.
+inline const char* advance(const char* begin,
+                           const char* end,
+                           index_type n,
+                           bool utf16)
+{
+  const char* it = begin;
+  while (n > 0 && it < end)
+  {
+    const char* next = simd::findNonAscii(it, std::min(end, it + n));
+    n -= next - it;
+    it = next;
+    if (n == 0 || it == end)
+      break;
+
+    index_type length = sequenceLength(it, end);
+    if (length == 0)
+      length = 1;
+
+    index_type width = utf16 && length == 4 ? 2 : 1;
+    if (width > n)
+      break;
+
+    n -= width;
+    it += length;
+  }
+
+  return it;
+}
+
 } // namespace utf8
 } // namespace sourcetools
 
@@ -4,8 +4,12 @@
 #include <sstream>
 #include <vector>
 
+#include <sourcetools/simd/simd.h>
 #include <sourcetools/collection/Position.h>
+#include <sourcetools/collection/LineIndex.h>
 #include <sourcetools/tokenization/Token.h>
+#include <sourcetools/tokenization/Tokenizer.h>
+#include <sourcetools/tokenization/TokenBuffer.h>
 #include <sourcetools/cursor/TokenCursor.h>
 
 namespace sourcetools {
@@ -44,12 +48,19 @@ private:
   std::string message_;
 };
 
-class SyntaxValidator {
+class SyntaxValidator : public tokenizer::TokenSink {
 
 private:
   typedef tokens::Token Token;
-  typedef cursors::TokenCursor TokenCursor;
   typedef tokens::TokenType TokenType;
+  typedef collections::Position Position;
+  typedef collections::LineIndex LineIndex;
+  typedef collections::ColumnUnit ColumnUnit;
+
+  Position position(const Token& token) const
+  {
+    return pIndex_ ? pIndex_->position(token.offset(), unit_) : token.position();
+  }
 
   void unexpectedToken(const Token& token, const std::string& expected = std::string())
   {
@@ -57,58 +68,114 @@ private:
     if (!expected.empty())
       message += " (expected '" + expected + "')";
 
-    errors_.push_back(SyntaxError(token.position(), message));
+    errors_.push_back(SyntaxError(position(token), message));
   }
 
-  void updateBracketStack(const Token& token, std::vector<TokenType>* pStack)
+  void updateBracketStack(const Token& token)
   {
     using namespace tokens;
 
     // Update brace state
     if (isLeftBracket(token)) {
-      pStack->push_back(token.type());
+      stack_.push_back(token.type());
     } else if (isRightBracket(token)) {
-      index_type size = pStack->size();
-      TokenType last = pStack->at(size - 1);
+      index_type size = stack_.size();
+      TokenType last = stack_.at(size - 1);
       if (size == 1) {
         unexpectedToken(token);
       } else {
         if (!isComplement(token.type(), last))
           unexpectedToken(token, toString(complement(last)));
-        pStack->pop_back();
+        stack_.pop_back();
       }
     }
   }
 
 public:
 
-  explicit SyntaxValidator(const std::vector<Token>& tokens)
+  // The validator is a token sink: it can be passed directly to
+  // 'sourcetools::tokenize()', and validates tokens as they're produced.
+  // As a sink, it only needs the tokens' offsets; the positions of
+  // reported errors are resolved through 'index', with columns counted
+  // in 'unit'.
+  static const bool INCLUDE_WHITESPACE = false;
+  static const bool INCLUDE_COMMENTS   = false;
+  static const bool TRACK_POSITIONS    = false;
+
+  explicit SyntaxValidator(const LineIndex& index,
+                           ColumnUnit unit = collections::COLUMN_BYTES)
+    : pIndex_(&index),
+      unit_(unit),
+      hasPreviousToken_(false),
+      stack_(1, tokens::INVALID)
   {
-    if (tokens.empty())
-      return;
-
-    TokenCursor cursor(tokens);
-    std::vector<TokenType> stack;
-    stack.push_back(tokens::INVALID);
+  }
 
-    const Token* pThisToken = &(cursor.currentToken());
-    const Token* pPrevToken = pThisToken;
+  explicit SyntaxValidator(const std::vector<Token>& tokens)
+    : pIndex_(NULL),
+      unit_(collections::COLUMN_BYTES),
+      hasPreviousToken_(false),
+      stack_(1, tokens::INVALID)
+  {
+    for (std::size_t i = 0, n = tokens.size(); i < n; ++i)
+      if (isSignificant(tokens[i].type()))
+        (*this)(tokens[i]);
+  }
 
-    while (cursor.moveToNextSignificantToken()) {
+  // Validate tokens produced without position tracking; the positions
+  // of reported errors are resolved through 'index'.
+  SyntaxValidator(const std::vector<Token>& tokens, const LineIndex& index)
+    : pIndex_(&index),
+      unit_(collections::COLUMN_BYTES),
+      hasPreviousToken_(false),
+      stack_(1, tokens::INVALID)
+  {
+    for (std::size_t i = 0, n = tokens.size(); i < n; ++i)
+      if (isSignificant(tokens[i].type()))
+        (*this)(tokens[i]);
+  }
 
-      pPrevToken = pThisToken;
-      pThisToken = &(cursor.currentToken());
+  explicit SyntaxValidator(const tokens::TokenBuffer& tokens)
+    : pIndex_(NULL),
+      unit_(collections::COLUMN_BYTES),
+      hasPreviousToken_(false),
+      stack_(1, tokens::INVALID)
+  {
+    for (index_type i = 0, n = tokens.size(); i < n; ++i)
+      if (isSignificant(tokens.type(i)))
+        (*this)(tokens[i]);
+  }
 
-      updateBracketStack(cursor.currentToken(), &stack);
-      executeValidators(*pPrevToken, *pThisToken);
+  void operator()(const Token& token)
+  {
+    updateBracketStack(token);
+    if (hasPreviousToken_)
+      executeValidators(previousToken_, token);
 
-    }
+    previousToken_ = token;
+    hasPreviousToken_ = true;
   }
 
   const std::vector<SyntaxError>& errors() const { return errors_; }
 
 private:
 
+  // Whether 'thisToken' starts on the row 'prevToken' starts on. Without
+  // positions, check for a newline between their starts, rather than
+  // resolving both through the line index.
+  static bool sameRow(const Token& prevToken, const Token& thisToken)
+  {
+    if (prevToken.hasPosition() && thisToken.hasPosition())
+      return prevToken.row() == thisToken.row();
+
+    return simd::find(prevToken.begin(), thisToken.begin(), '\n') == thisToken.begin();
+  }
+
+  static bool isSignificant(TokenType type)
+  {
+    return type != tokens::WHITESPACE && type != tokens::COMMENT;
+  }
+
   void executeValidators(const tokens::Token& prevToken,
                          const tokens::Token& thisToken)
   {
@@ -134,12 +201,17 @@ private:
     else if (isSymbolic(prevToken)) {
 
       // Two symbols on the same line.
-      if (isSymbolic(thisToken) && prevToken.row() == thisToken.row())
+      if (isSymbolic(thisToken) && sameRow(prevToken, thisToken))
         unexpectedToken(thisToken);
     }
 
   }
 
+  const LineIndex* pIndex_;
+  ColumnUnit unit_;
+  Token previousToken_;
+  bool hasPreviousToken_;
+  std::vector<TokenType> stack_;
   std::vector<SyntaxError> errors_;
 
 };
@@ -7,13 +7,14 @@ extern "C" SEXP sourcetools_performs_nse(SEXP fnSEXP)
   if (TYPEOF(fnSEXP) == VECSXP || TYPEOF(fnSEXP) == EXPRSXP)
   {
     Protect protect;
+    nse::Database database;
     index_type n = Rf_length(fnSEXP);
     SEXP resultSEXP = protect(Rf_allocVector(LGLSXP, n));
     for (index_type i = 0; i < n; ++i)
     {
       SEXP elSEXP = VECTOR_ELT(fnSEXP, i);
       LOGICAL(resultSEXP)[i] = Rf_isFunction(elSEXP)
-        ? nse::performsNonStandardEvaluation(elSEXP)
+        ? database.check(elSEXP)
         : 0;
     }
     return resultSEXP;
@@ -17,8 +17,8 @@ void log(parser::ParseNode* pNode, int depth)
   Rprintf("%s\n", toString(pNode->token()).c_str());
 
   using parser::ParseNode;
-  const std::vector<ParseNode*>& children = pNode->children();
-  for (std::vector<ParseNode*>::const_iterator it = children.begin();
+  const ParseNode::Children& children = pNode->children();
+  for (ParseNode::Children::const_iterator it = children.begin();
        it != children.end();
        ++it)
   {
@@ -33,6 +33,45 @@ class SEXPConverter
 private:
   typedef parser::ParseNode ParseNode;
 
+  // 'Rf_install()' results for each interned symbol, indexed by id. R never
+  // releases symbols, so these don't need protection.
+  std::vector<SEXP> symbols_;
+
+  // Scratch space for decoding string values with escapes, and for
+  // nul-terminating names passed to 'Rf_install()'.
+  std::string buffer_;
+  std::string name_;
+
+  SEXP installSymbol(const tokens::Token& token)
+  {
+    collections::SymbolId id = token.symbol();
+    if (id == collections::NO_SYMBOL)
+      return installValue(token);
+
+    if (id >= symbols_.size())
+      symbols_.resize(id + 1, NULL);
+
+    if (symbols_[id] == NULL)
+      symbols_[id] = installValue(token);
+
+    return symbols_[id];
+  }
+
+  SEXP installValue(const tokens::Token& token)
+  {
+    StringView value = tokens::stringValue(token, &buffer_);
+    name_.assign(value.begin(), value.size());
+    return Rf_install(name_.c_str());
+  }
+
+  SEXP asStringSEXP(const tokens::Token& token)
+  {
+    // As with 'Rf_mkString()', the value ends at the first embedded nul.
+    StringView value = tokens::stringValue(token, &buffer_);
+    const char* end = std::find(value.begin(), value.end(), '\0');
+    return Rf_ScalarString(Rf_mkCharLen(value.begin(), end - value.begin()));
+  }
+
   static SEXP asKeywordSEXP(const tokens::Token& token)
   {
     using namespace tokens;
@@ -53,7 +92,7 @@ private:
     }
   }
 
-  static SEXP asFunctionCallSEXP(const ParseNode* pNode)
+  SEXP asFunctionCallSEXP(const ParseNode* pNode)
   {
     using namespace tokens;
 
@@ -73,7 +112,7 @@ private:
     // Start appending the child nodes to our list.
     r::Protect protect;
     SEXP headSEXP = protect(langSEXP);
-    for (std::vector<ParseNode*>::const_iterator it = pNode->children().begin();
+    for (ParseNode::Children::const_iterator it = pNode->children().begin();
          it != pNode->children().end();
          ++it)
     {
@@ -95,7 +134,7 @@ private:
           SETCDR(langSEXP, Rf_lang1(asSEXP(rhs)));
 
         const Token& token = lhs->token();
-        SEXP nameSEXP = Rf_install(tokens::stringValue(token).c_str());
+        SEXP nameSEXP = installSymbol(token);
         SET_TAG(CDR(langSEXP), nameSEXP);
       }
       else
@@ -117,7 +156,7 @@ private:
     return resultSEXP;
   }
 
-  static SEXP asFunctionArgumentListSEXP(const ParseNode* pNode)
+  SEXP asFunctionArgumentListSEXP(const ParseNode* pNode)
   {
     index_type n = pNode->children().size();
     if (n == 0)
@@ -126,7 +165,7 @@ private:
     r::Protect protect;
     SEXP listSEXP = protect(Rf_allocList(n));
     SEXP headSEXP = listSEXP;
-    for (std::vector<ParseNode*>::const_iterator it = pNode->children().begin();
+    for (ParseNode::Children::const_iterator it = pNode->children().begin();
          it != pNode->children().end();
          ++it)
     {
@@ -139,13 +178,13 @@ private:
         const ParseNode* pRhs = pChild->children()[1];
 
         if (pLhs->token().isType(tokens::SYMBOL))
-          SET_TAG(headSEXP, Rf_install(tokens::stringValue(pLhs->token()).c_str()));
+          SET_TAG(headSEXP, installSymbol(pLhs->token()));
         SETCAR(headSEXP, asSEXP(pRhs));
       }
       else if (token.isType(tokens::SYMBOL))
       {
         SETCAR(headSEXP, R_MissingArg);
-        SET_TAG(headSEXP, Rf_install(tokens::stringValue(token).c_str()));
+        SET_TAG(headSEXP, installSymbol(token));
       }
 
       headSEXP = CDR(headSEXP);
@@ -154,7 +193,7 @@ private:
     return listSEXP;
   }
 
-  static SEXP asFunctionDeclSEXP(const ParseNode* pNode)
+  SEXP asFunctionDeclSEXP(const ParseNode* pNode)
   {
     if (pNode->children().size() != 2)
       return R_NilValue;
@@ -169,10 +208,21 @@ private:
 
   static SEXP asNumericSEXP(const tokens::Token& token)
   {
-    if (*(token.end() - 1) == 'L')
-      return Rf_ScalarInteger(::atof(token.begin()));
-    else
-      return Rf_ScalarReal(::atof(token.begin()));
+    tokens::NumericValue value = tokens::numericValue(token);
+    switch (value.type)
+    {
+    case tokens::NUMERIC_INTEGER:
+      return Rf_ScalarInteger(static_cast<int>(value.value));
+    case tokens::NUMERIC_COMPLEX:
+    {
+      Rcomplex complex;
+      complex.r = 0;
+      complex.i = value.value;
+      return Rf_ScalarComplex(complex);
+    }
+    default:
+      return Rf_ScalarReal(value.value);
+    }
   }
 
   static bool isFunctionCall(const ParseNode* pNode)
@@ -189,7 +239,7 @@ private:
   }
 
 public:
-  static SEXP asSEXP(const ParseNode* pNode)
+  SEXP asSEXP(const ParseNode* pNode)
   {
     using namespace tokens;
 
@@ -198,7 +248,7 @@ public:
 
     if (pNode->token().isType(tokens::ROOT))
     {
-      const std::vector<ParseNode*>& children = pNode->children();
+      const ParseNode::Children& children = pNode->children();
       index_type n = pNode->children().size();
       r::Protect protect;
       SEXP exprSEXP = protect(Rf_allocVector(EXPRSXP, n));
@@ -232,9 +282,9 @@ public:
     else if (isNumeric(token))
       elSEXP = asNumericSEXP(token);
     else if (isSymbol(token))
-      elSEXP = Rf_install(tokens::stringValue(token).c_str());
+      elSEXP = installSymbol(token);
     else if (isString(token))
-      elSEXP = Rf_mkString(tokens::stringValue(token).c_str());
+      elSEXP = asStringSEXP(token);
     else
       elSEXP = Rf_mkString(token.contents().c_str());
 
@@ -243,7 +293,7 @@ public:
 
     SEXP headSEXP = protect(Rf_lang1(protect(elSEXP)));
     SEXP listSEXP = headSEXP;
-    for (std::vector<ParseNode*>::const_iterator it = pNode->children().begin();
+    for (ParseNode::Children::const_iterator it = pNode->children().begin();
          it != pNode->children().end();
          ++it)
     {
@@ -255,7 +305,7 @@ public:
     return headSEXP;
   }
 
-  static SEXP asSEXP(const std::vector<ParseNode*>& expression)
+  SEXP asSEXP(const std::vector<ParseNode*>& expression)
   {
     index_type n = expression.size();
     r::Protect protect;
@@ -267,7 +317,10 @@ public:
 
 };
 
-void reportErrors(const std::vector<parser::ParseError>& errors)
+// Errors are reported with columns counted in 'unit', through 'index'.
+void reportErrors(const std::vector<parser::ParseError>& errors,
+                  const collections::LineIndex& index,
+                  collections::ColumnUnit unit)
 {
   if (errors.empty())
     return;
@@ -279,7 +332,8 @@ void reportErrors(const std::vector<parser::ParseError>& errors)
        it != errors.end();
        ++it)
   {
-    ss << "[" << it->start().row << ":" << it->start().column << "]: "
+    collections::Position start = it->start(index, unit);
+    ss << "[" << start.row << ":" << start.column << "]: "
        << it->message() << std::endl << "  ";
   }
 
@@ -289,7 +343,7 @@ void reportErrors(const std::vector<parser::ParseError>& errors)
 } // anonymous namespace
 } // namespace sourcetools
 
-extern "C" SEXP sourcetools_parse_string(SEXP programSEXP)
+extern "C" SEXP sourcetools_parse_string(SEXP programSEXP, SEXP unitSEXP)
 {
   using namespace sourcetools;
   using parser::ParseStatus;
@@ -297,14 +351,22 @@ extern "C" SEXP sourcetools_parse_string(SEXP programSEXP)
   using parser::ParseNode;
 
   SEXP charSEXP = STRING_ELT(programSEXP, 0);
-  Parser parser(CHAR(charSEXP), Rf_length(charSEXP));
+  collections::SymbolTable symbols;
+  Parser parser(CHAR(charSEXP), Rf_length(charSEXP), &symbols);
 
   ParseStatus status;
-  scoped_ptr<ParseNode> pRoot(parser.parse(&status));
+  ParseNode* pRoot = parser.parse(&status);
 
-  sourcetools::reportErrors(status.getErrors());
+  if (!status.getErrors().empty())
+  {
+    collections::ColumnUnit unit = r::util::columnUnit(unitSEXP);
+    collections::LineIndex index(CHAR(charSEXP), Rf_length(charSEXP));
+    r::util::checkColumnUnit(index, unit);
+    sourcetools::reportErrors(status.getErrors(), index, unit);
+  }
 
-  return sourcetools::SEXPConverter::asSEXP(pRoot);
+  sourcetools::SEXPConverter converter;
+  return converter.asSEXP(pRoot);
 }
 
 extern "C" SEXP sourcetools_diagnose_string(SEXP strSEXP)
@@ -316,10 +378,11 @@ extern "C" SEXP sourcetools_diagnose_string(SEXP strSEXP)
   using r::Protect;
 
   SEXP charSEXP = STRING_ELT(strSEXP, 0);
-  Parser parser(CHAR(charSEXP), Rf_length(charSEXP));
+  collections::SymbolTable symbols;
+  Parser parser(CHAR(charSEXP), Rf_length(charSEXP), &symbols);
 
   ParseStatus status;
-  scoped_ptr<ParseNode> pNode(parser.parse(&status));
+  ParseNode* pNode = parser.parse(&status);
 
   using namespace diagnostics;
   scoped_ptr<DiagnosticsSet> pDiagnostics(createDefaultDiagnosticsSet());
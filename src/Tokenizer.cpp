@@ -19,59 +19,119 @@ void asDataFrame(SEXP listSEXP, int n)
   Rf_setAttrib(listSEXP, R_RowNamesSymbol, rownamesSEXP);
 }
 
-SEXP asSEXP(const std::vector<tokens::Token>& tokens)
+// Builds the token data frame returned to R, one token at a time, growing
+// its columns as needed. Columns are counted in bytes, as the tokenizer
+// tracks them, unless a line index is given to count them in 'unit' (on
+// from the previous token, as tokens arrive in order).
+class TokenDataFrameBuilder : public tokenizer::TokenSink, noncopyable
 {
-  r::Protect protect;
-  index_type n = tokens.size();
-  SEXP resultSEXP = protect(Rf_allocVector(VECSXP, 4));
-
-  // Set vector elements
-  SEXP valueSEXP = protect(Rf_allocVector(STRSXP, n));
-  SET_VECTOR_ELT(resultSEXP, 0, valueSEXP);
-  for (index_type i = 0; i < n; ++i) {
-    const std::string& contents = tokens[i].contents();
-    SET_STRING_ELT(valueSEXP, i, r::createChar(contents));
+public:
+
+  explicit TokenDataFrameBuilder(
+      const collections::LineIndex* pIndex = NULL,
+      collections::ColumnUnit unit = collections::COLUMN_BYTES)
+    : pCursor_(pIndex ? new collections::LineIndex::Cursor(*pIndex, unit) : NULL),
+      n_(0),
+      capacity_(0)
+  {
+    resultSEXP_ = protect_(Rf_allocVector(VECSXP, 4));
+    SET_VECTOR_ELT(resultSEXP_, 0, Rf_allocVector(STRSXP, 0));
+    SET_VECTOR_ELT(resultSEXP_, 1, Rf_allocVector(INTSXP, 0));
+    SET_VECTOR_ELT(resultSEXP_, 2, Rf_allocVector(INTSXP, 0));
+    SET_VECTOR_ELT(resultSEXP_, 3, Rf_allocVector(STRSXP, 0));
+    resize(1024);
+  }
+
+  void operator()(const tokens::Token& token)
+  {
+    if (n_ == capacity_)
+      resize(2 * capacity_);
+
+    SEXP valueSEXP = r::createChar(token.begin(), token.size());
+    SET_STRING_ELT(VECTOR_ELT(resultSEXP_, 0), n_, valueSEXP);
+
+    collections::Position position = pCursor_ ?
+      pCursor_->position(token.offset()) :
+      token.position();
+
+    pRows_[n_] = position.row + 1;
+    pColumns_[n_] = position.column + 1;
+
+    SEXP typeSEXP = r::createChar(toString(token.type()));
+    SET_STRING_ELT(VECTOR_ELT(resultSEXP_, 3), n_, typeSEXP);
+
+    ++n_;
   }
 
-  SEXP rowSEXP = protect(Rf_allocVector(INTSXP, n));
-  SET_VECTOR_ELT(resultSEXP, 1, rowSEXP);
-  for (index_type i = 0; i < n; ++i)
-    INTEGER(rowSEXP)[i] = tokens[i].row() + 1;
-
-  SEXP columnSEXP = protect(Rf_allocVector(INTSXP, n));
-  SET_VECTOR_ELT(resultSEXP, 2, columnSEXP);
-  for (index_type i = 0; i < n; ++i)
-    INTEGER(columnSEXP)[i] = tokens[i].column() + 1;
-
-  SEXP typeSEXP = protect(Rf_allocVector(STRSXP, n));
-  SET_VECTOR_ELT(resultSEXP, 3, typeSEXP);
-  for (index_type i = 0; i < n; ++i) {
-    const std::string& type = toString(tokens[i].type());
-    SET_STRING_ELT(typeSEXP, i, r::createChar(type));
+  SEXP data()
+  {
+    resize(n_);
+
+    // Set names
+    r::Protect protect;
+    SEXP namesSEXP = protect(Rf_allocVector(STRSXP, 4));
+
+    SET_STRING_ELT(namesSEXP, 0, Rf_mkChar("value"));
+    SET_STRING_ELT(namesSEXP, 1, Rf_mkChar("row"));
+    SET_STRING_ELT(namesSEXP, 2, Rf_mkChar("column"));
+    SET_STRING_ELT(namesSEXP, 3, Rf_mkChar("type"));
+
+    Rf_setAttrib(resultSEXP_, R_NamesSymbol, namesSEXP);
+
+    asDataFrame(resultSEXP_, n_);
+
+    return resultSEXP_;
   }
 
-  // Set names
-  SEXP namesSEXP = protect(Rf_allocVector(STRSXP, 4));
+private:
+
+  // The columns are always owned by (and hence protected through) the
+  // result list, including while they're being reallocated.
+  void resize(index_type capacity)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      SEXP columnSEXP = Rf_lengthgets(VECTOR_ELT(resultSEXP_, i), capacity);
+      SET_VECTOR_ELT(resultSEXP_, i, columnSEXP);
+    }
+
+    pRows_ = INTEGER(VECTOR_ELT(resultSEXP_, 1));
+    pColumns_ = INTEGER(VECTOR_ELT(resultSEXP_, 2));
+    capacity_ = capacity;
+  }
 
-  SET_STRING_ELT(namesSEXP, 0, Rf_mkChar("value"));
-  SET_STRING_ELT(namesSEXP, 1, Rf_mkChar("row"));
-  SET_STRING_ELT(namesSEXP, 2, Rf_mkChar("column"));
-  SET_STRING_ELT(namesSEXP, 3, Rf_mkChar("type"));
+  scoped_ptr<collections::LineIndex::Cursor> pCursor_;
+  r::Protect protect_;
+  SEXP resultSEXP_;
+  int* pRows_;
+  int* pColumns_;
+  index_type n_;
+  index_type capacity_;
+};
 
-  Rf_setAttrib(resultSEXP, R_NamesSymbol, namesSEXP);
+SEXP tokenizeToDataFrame(const char* code, index_type n, SEXP unitSEXP)
+{
+  collections::ColumnUnit unit = r::util::columnUnit(unitSEXP);
+  if (unit == collections::COLUMN_BYTES)
+  {
+    TokenDataFrameBuilder builder;
+    tokenize(code, n, builder);
+    return builder.data();
+  }
 
-  asDataFrame(resultSEXP, n);
+  collections::LineIndex index(code, n);
+  r::util::checkColumnUnit(index, unit);
 
-  return resultSEXP;
+  TokenDataFrameBuilder builder(&index, unit);
+  tokenize(code, n, builder);
+  return builder.data();
 }
 
 } // anonymous namespace
 } // namespace sourcetools
 
-extern "C" SEXP sourcetools_tokenize_file(SEXP absolutePathSEXP)
+extern "C" SEXP sourcetools_tokenize_file(SEXP absolutePathSEXP, SEXP unitSEXP)
 {
-  typedef sourcetools::tokens::Token Token;
-
   const char* absolutePath = CHAR(STRING_ELT(absolutePathSEXP, 0));
   std::string contents;
   if (!sourcetools::read(absolutePath, &contents))
@@ -81,19 +141,14 @@ extern "C" SEXP sourcetools_tokenize_file(SEXP absolutePathSEXP)
   }
 
   if (contents.empty()) return R_NilValue;
-  const std::vector<Token>& tokens = sourcetools::tokenize(contents);
-  return sourcetools::asSEXP(tokens);
+  return sourcetools::tokenizeToDataFrame(contents.data(), contents.size(), unitSEXP);
 }
 
-extern "C" SEXP sourcetools_tokenize_string(SEXP stringSEXP)
+extern "C" SEXP sourcetools_tokenize_string(SEXP stringSEXP, SEXP unitSEXP)
 {
-  typedef sourcetools::tokens::Token Token;
-
   if (Rf_length(stringSEXP) == 0)
-    return sourcetools::asSEXP(std::vector<Token>());
+    return sourcetools::tokenizeToDataFrame("", 0, unitSEXP);
 
   SEXP charSEXP = STRING_ELT(stringSEXP, 0);
-  const std::vector<Token>& tokens =
-    sourcetools::tokenize(CHAR(charSEXP), Rf_length(charSEXP));
-  return sourcetools::asSEXP(tokens);
+  return sourcetools::tokenizeToDataFrame(CHAR(charSEXP), Rf_length(charSEXP), unitSEXP);
 }
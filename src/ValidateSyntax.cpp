@@ -32,7 +32,7 @@ struct ErrSetter
 
 } // anonymous namespace
 
-extern "C" SEXP sourcetools_validate_syntax(SEXP contentsSEXP) {
+extern "C" SEXP sourcetools_validate_syntax(SEXP contentsSEXP, SEXP unitSEXP) {
   using namespace sourcetools;
   using namespace sourcetools::tokens;
   using namespace sourcetools::validators;
@@ -41,12 +41,22 @@ extern "C" SEXP sourcetools_validate_syntax(SEXP contentsSEXP) {
   if (Rf_length(contentsSEXP) == 0)
     contentsSEXP = protect(Rf_mkString(""));
 
-  const char* contents = CHAR(STRING_ELT(contentsSEXP, 0));
-  const std::vector<tokens::Token>& tokens = sourcetools::tokenize(contents);
+  // Validate tokens as they're produced, without collecting them. The
+  // validator doesn't ask for positions while tokenizing; they're only
+  // resolved (through the line index) for the tokens we report errors for,
+  // with columns counted in the requested unit.
+  SEXP charSEXP = STRING_ELT(contentsSEXP, 0);
+  const char* contents = CHAR(charSEXP);
+  index_type n = Rf_length(charSEXP);
+
+  collections::ColumnUnit unit = r::util::columnUnit(unitSEXP);
+  collections::LineIndex index(contents, n);
+  r::util::checkColumnUnit(index, unit);
+
+  SyntaxValidator validator(index, unit);
+  sourcetools::tokenize(contents, n, validator);
 
-  SyntaxValidator validator(tokens);
   const std::vector<SyntaxError>& errors = validator.errors();
-  index_type n = errors.size();
 
   r::RObjectFactory factory;
   SEXP resultSEXP = factory.create(VECSXP, 3);
@@ -56,7 +66,7 @@ extern "C" SEXP sourcetools_validate_syntax(SEXP contentsSEXP) {
 
   const char* names[] = {"row", "column", "error"};
   r::util::setNames(resultSEXP, names, 3);
-  r::util::listToDataFrame(resultSEXP, n);
+  r::util::listToDataFrame(resultSEXP, errors.size());
 
   return resultSEXP;
 }
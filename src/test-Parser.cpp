@@ -1,6 +1,12 @@
+#include <map>
+
 #include <testthat.h>
 #include <sourcetools.h>
 
+#ifdef SOURCETOOLS_COMPILER_CXX11
+# include <thread>
+#endif
+
 using namespace sourcetools;
 using namespace sourcetools::parser;
 using namespace sourcetools::cursors;
@@ -8,6 +14,129 @@ using namespace sourcetools::collections;
 
 typedef sourcetools::tokens::Token Token;
 
+namespace {
+
+void collect(const ParseNode* pNode, std::vector<const ParseNode*>* pNodes)
+{
+  pNodes->push_back(pNode);
+  const ParseNode::Children& children = pNode->children();
+  for (ParseNode::Children::const_iterator it = children.begin();
+       it != children.end();
+       ++it)
+  {
+    collect(*it, pNodes);
+  }
+}
+
+std::string repeat(const std::string& text, index_type times)
+{
+  std::string result;
+  result.reserve(text.size() * times);
+  for (index_type i = 0; i < times; ++i)
+    result += text;
+  return result;
+}
+
+// The depth of the deepest node in a tree (walked without recursion, as
+// the trees here are too deep to recurse over).
+index_type depth(const ParseNode* pRoot)
+{
+  index_type result = 0;
+  std::vector<std::pair<const ParseNode*, index_type> > stack;
+  stack.push_back(std::make_pair(pRoot, index_type(0)));
+  while (!stack.empty())
+  {
+    const ParseNode* pNode = stack.back().first;
+    index_type level = stack.back().second;
+    stack.pop_back();
+
+    result = std::max(result, level);
+    const ParseNode::Children& children = pNode->children();
+    for (index_type i = 0; i < utils::size(children); ++i)
+      stack.push_back(std::make_pair(children[i], level + 1));
+  }
+  return result;
+}
+
+bool sameToken(const Token& lhs, const Token& rhs)
+{
+  return lhs.begin() == rhs.begin() &&
+         lhs.size() == rhs.size() &&
+         lhs.offset() == rhs.offset() &&
+         lhs.type() == rhs.type() &&
+         lhs.position() == rhs.position() &&
+         lhs.newlines() == rhs.newlines();
+}
+
+bool sameTree(const ParseNode* pLhs, const ParseNode* pRhs)
+{
+  std::vector<std::pair<const ParseNode*, const ParseNode*> > stack;
+  stack.push_back(std::make_pair(pLhs, pRhs));
+  while (!stack.empty())
+  {
+    const ParseNode* pLhsNode = stack.back().first;
+    const ParseNode* pRhsNode = stack.back().second;
+    stack.pop_back();
+
+    const ParseNode::Children& lhs = pLhsNode->children();
+    const ParseNode::Children& rhs = pRhsNode->children();
+    if (!sameToken(pLhsNode->token(), pRhsNode->token()) ||
+        !sameToken(pLhsNode->begin(), pRhsNode->begin()) ||
+        !sameToken(pLhsNode->end(), pRhsNode->end()) ||
+        lhs.size() != rhs.size())
+    {
+      return false;
+    }
+
+    for (std::size_t i = 0; i < lhs.size(); ++i)
+      stack.push_back(std::make_pair(lhs[i], rhs[i]));
+  }
+
+  return true;
+}
+
+// Tokenize, parse and lint 'code', summarizing what we found (to compare
+// the results of doing so on different threads).
+struct Analysis
+{
+  std::size_t tokens;
+  std::size_t errors;
+  std::size_t diagnostics;
+  std::size_t symbols;
+};
+
+Analysis analyze(const std::string& code, ParseStatus* pStatus)
+{
+  Analysis analysis;
+  analysis.tokens = sourcetools::tokenize(code).size();
+
+  SymbolTable symbols;
+  ParseNode* pRoot = Parser(code, &symbols).parse(pStatus);
+  analysis.errors = pStatus->getErrors().size();
+  analysis.symbols = symbols.size();
+
+  // (The default set also has a checker that looks up the objects on R's
+  // search path, which can only be done on R's thread.)
+  using namespace diagnostics::checkers;
+  diagnostics::DiagnosticsSet set;
+  set.add(new AssignmentInIfChecker);
+  set.add(new ComparisonWithNullChecker);
+  set.add(new ScalarOpsInIfChecker);
+  set.add(new UnusedResultChecker);
+  analysis.diagnostics = set.run(pRoot).size();
+  return analysis;
+}
+
+bool operator==(const Analysis& lhs, const Analysis& rhs)
+{
+  return lhs.tokens == rhs.tokens &&
+         lhs.errors == rhs.errors &&
+         lhs.diagnostics == rhs.diagnostics &&
+         lhs.symbols == rhs.symbols;
+}
+
+} // anonymous namespace
+
 context("Parser") {
 
   test_that("we can extract partial parse trees from code")
@@ -18,7 +147,7 @@ context("Parser") {
     Parser parser(code);
 
     ParseStatus status;
-    scoped_ptr<ParseNode> pRoot(parser.parse(&status));
+    parser.parse(&status);
 
     TokenCursor cursor(tokens);
     expect_true(cursor.findFwd("="));
@@ -46,6 +175,452 @@ context("Parser") {
     pTarget->bounds(&begin, &end);
     contents = std::string(begin, end);
     expect_true(contents == "{1 + 2}");
+
+    // Positions without a token don't have a node.
+    expect_true(status.getNodeAtPosition(Position(0, 1)) == NULL);
+    expect_true(status.getNodeAtPosition(Position(5, 0)) == NULL);
+    expect_true(status.getNodeAtPosition(Position(0, 0)) != NULL);
+  }
+
+  test_that("Flat trees mirror the parse tree")
+  {
+    std::string code =
+      "foo <- function(a, b = 2) {\n  a + b\n}\n"
+      "x[[1]] <- if (y) 1 else c(2, 3)\n";
+
+    Parser parser(code);
+    ParseStatus status;
+    ParseNode* pRoot = parser.parse(&status);
+
+    std::vector<const ParseNode*> nodes;
+    collect(pRoot, &nodes);
+
+    FlatTree tree(code.data(), pRoot);
+    expect_true(tree.size() == utils::size(nodes));
+    if (tree.size() != utils::size(nodes))
+      return;
+
+    for (index_type i = 0; i < tree.size(); ++i)
+    {
+      const FlatNode& node = tree[i];
+      const ParseNode* pNode = nodes[i];
+      expect_true(node.type == pNode->token().type());
+      expect_true(tree.token(i).contents() == pNode->token().contents());
+
+      // Links agree with the pointer-based tree.
+      if (node.parent == FlatTree::NONE)
+        expect_true(pNode->parent() == NULL);
+      else
+        expect_true(nodes[node.parent] == pNode->parent());
+
+      index_type count = 0;
+      for (index_type child = node.firstChild;
+           child != FlatTree::NONE;
+           child = tree[child].nextSibling)
+      {
+        expect_true(nodes[child] == pNode->children()[count]);
+        ++count;
+      }
+      expect_true(count == utils::size(pNode->children()));
+    }
+
+    // Find the innermost node at an offset.
+    index_type index = tree.find(code.find("a + b"));
+    expect_true(index != FlatTree::NONE);
+    if (index != FlatTree::NONE)
+      expect_true(tree.token(index).contentsEqual("a"));
+
+    index = tree.find(code.find("+ b"));
+    expect_true(index != FlatTree::NONE);
+    if (index != FlatTree::NONE)
+    {
+      const FlatNode& node = tree[index];
+      expect_true(tree.token(index).contentsEqual("+"));
+      expect_true(code.substr(node.begin, node.end - node.begin) == "a + b");
+    }
+
+    expect_true(tree.find(code.size()) == FlatTree::NONE);
+
+    // Nodes can be copied out and back as a block of memory.
+    std::vector<char> bytes(tree.size() * sizeof(FlatNode));
+    std::memcpy(&bytes[0], tree.data(), bytes.size());
+
+    FlatTree copy(code.data(),
+                  reinterpret_cast<const FlatNode*>(&bytes[0]),
+                  tree.size());
+    expect_true(copy.size() == tree.size());
+    expect_true(std::memcmp(copy.data(), tree.data(), bytes.size()) == 0);
+  }
+
+  test_that("Nodes are found by the positions of their tokens")
+  {
+    std::string code =
+      "f <- function(a, b = \"x\ny\") {\n  a[[1]] + -b\n}\n"
+      "if (x) y else z; g(h = 1, )\n"
+      "k <- 1 ->> m\n";
+
+    ParseStatus status;
+    Parser(code).parse(&status);
+
+    // The first node (in pre-order) for each token.
+    std::map<std::pair<index_type, index_type>, const ParseNode*> expected;
+    std::vector<const ParseNode*> stack(1, status.root());
+    while (!stack.empty())
+    {
+      const ParseNode* pNode = stack.back();
+      stack.pop_back();
+
+      const Token& token = pNode->token();
+      if (token.hasPosition())
+        expected.insert(std::make_pair(std::make_pair(token.row(), token.column()), pNode));
+
+      const ParseNode::Children& children = pNode->children();
+      for (index_type i = utils::size(children) - 1; i >= 0; --i)
+        stack.push_back(children[i]);
+    }
+
+    typedef std::map<std::pair<index_type, index_type>, const ParseNode*>::const_iterator Iterator;
+    for (Iterator it = expected.begin(); it != expected.end(); ++it)
+    {
+      Position position(it->first.first, it->first.second);
+      expect_true(status.getNodeAtPosition(position) == it->second);
+    }
+
+    // Past the end of a row, or of the document.
+    expect_true(status.getNodeAtPosition(Position(0, 100)) == NULL);
+    expect_true(status.getNodeAtPosition(Position(100, 0)) == NULL);
+  }
+
+  test_that("Re-parsing after an edit matches parsing from scratch")
+  {
+    std::string original =
+      "x <- f(1,\n  2); y <- 3\n"
+      "g <- function(a, b = 2) {\n  a + b\n}\n"
+      "if (x) y else\n  z\n"
+      "s <- \"a\nb\"; v[[1\n]] <- 0x1F\n"
+      "h(]; k\n";
+
+    const char* replacements[] = {
+      "", "-", "\n", "\"", "#", "(", ")", "{", "}", "[", "]]", ";", ",",
+      "1", "else", "function(", " + ", "\n+ 1"
+    };
+
+    index_type n = original.size();
+    for (index_type begin = 0; begin <= n; ++begin)
+    {
+      for (index_type end = begin; end <= n && end <= begin + 2; ++end)
+      {
+        for (std::size_t i = 0; i < 2 * sizeof(replacements) / sizeof(replacements[0]); ++i)
+        {
+          // With and without tokens to update alongside the tree.
+          const char* replacement = replacements[i / 2];
+          std::string code = original;
+          std::vector<Token> tokens = sourcetools::tokenize(code);
+          ParseStatus status;
+          Parser(code).parse(&status);
+          if (i % 2 == 0)
+            reparse(&code, &status, begin, end, replacement);
+          else
+            reparse(&code, &tokens, &status, begin, end, replacement);
+          ParseNode* pActual = status.root();
+
+          ParseStatus expected;
+          ParseNode* pExpected = Parser(code).parse(&expected);
+          expect_true(sameTree(pActual, pExpected));
+
+          const std::vector<ParseError>& actualErrors = status.getErrors();
+          const std::vector<ParseError>& expectedErrors = expected.getErrors();
+          expect_true(actualErrors.size() == expectedErrors.size());
+          if (actualErrors.size() != expectedErrors.size())
+            continue;
+
+          for (std::size_t j = 0; j < expectedErrors.size(); ++j)
+          {
+            expect_true(actualErrors[j].start() == expectedErrors[j].start());
+            expect_true(actualErrors[j].end() == expectedErrors[j].end());
+            expect_true(actualErrors[j].message() == expectedErrors[j].message());
+          }
+        }
+      }
+    }
+  }
+
+  test_that("Expressions moved by several re-parses are brought up to date when asked for")
+  {
+    std::string code =
+      "f <- function(x) {\n  x + 1\n}\n"
+      "g <- 1; h <- 2\n"
+      "k <- list(a = 1,\n  b = 2)\n"
+      "m <- \"s\\nt\"\n";
+
+    ParseStatus status;
+    Parser(code).parse(&status);
+
+    // Edits near the top move everything after them, on this row or below.
+    reparse(&code, &status, 5, 5, "\n");
+    reparse(&code, &status, 0, 1, "ff");
+    reparse(&code, &status, code.find("g <-"), code.find("g <-") + 1, "gg\n\n");
+
+    ParseStatus expected;
+    ParseNode* pExpected = Parser(code).parse(&expected);
+
+    // Individual expressions first, and then the whole tree.
+    const ParseNode::Children& children = pExpected->children();
+    for (index_type i = utils::size(children) - 1; i >= 0; --i)
+      expect_true(sameTree(status.expression(i), children[i]));
+    expect_true(sameTree(status.root(), pExpected));
+
+    // Appending enough to move the text moves every expression, including
+    // those with a shift still to apply.
+    reparse(&code, &status, 0, 0, "\n");
+    reparse(&code, &status, code.size(), code.size(), "z <- 1\n" + repeat("\n", 1000));
+    ParseStatus appended;
+    expect_true(sameTree(status.root(), Parser(code).parse(&appended)));
+  }
+
+  test_that("Parallel parsing produces the same tree as sequential parsing")
+  {
+    std::string code =
+      "x <- f(1,\n  2); y <- 3\n"
+      "g <- function(a, b = 2)\n{\n  a + b\n}\n"
+      "if (x) y else\n  z\n"
+      "for (i in 1:10)\n  print(i)\n"
+      "repeat\n  break\n"
+      "a <- 1 +\n  2\n"
+      "b <- 1\n+ 2\n"
+      "s <- \"a\nb\"; v[[1\n]] <- 0x1F\n"
+      "# comment\n"
+      "h(]; k\n"
+      "(1\n+ 2)\n"
+      "w <- x[\n1]\n";
+
+    ParseStatus expected;
+    ParseNode* pExpected = Parser(code).parse(&expected);
+
+    for (index_type chunkSize = 1; chunkSize < 96; chunkSize += 5)
+    {
+      for (index_type threads = 2; threads <= 3; ++threads)
+      {
+        // Use the parser directly: 'parseParallel()' would parse a
+        // document this small sequentially.
+        ParseStatus status;
+        ParallelParser parser(code.data(), code.size(), threads, chunkSize);
+        ParseNode* pActual = parser.parse(&status);
+        expect_true(sameTree(pActual, pExpected));
+
+        const std::vector<ExpressionStart>& actualStarts = status.getExpressionStarts();
+        const std::vector<ExpressionStart>& expectedStarts = expected.getExpressionStarts();
+        expect_true(actualStarts.size() == expectedStarts.size());
+        for (std::size_t i = 0; i < actualStarts.size() && i < expectedStarts.size(); ++i)
+        {
+          expect_true(actualStarts[i].offset == expectedStarts[i].offset);
+          expect_true(actualStarts[i].errors == expectedStarts[i].errors);
+          expect_true(actualStarts[i].position == expectedStarts[i].position);
+        }
+
+        const std::vector<ParseError>& actualErrors = status.getErrors();
+        const std::vector<ParseError>& expectedErrors = expected.getErrors();
+        expect_true(actualErrors.size() == expectedErrors.size());
+        for (std::size_t i = 0; i < actualErrors.size() && i < expectedErrors.size(); ++i)
+        {
+          expect_true(actualErrors[i].start() == expectedErrors[i].start());
+          expect_true(actualErrors[i].message() == expectedErrors[i].message());
+        }
+      }
+    }
+  }
+
+  test_that("Parallel parsing only uses the threads that can help")
+  {
+    index_type megabyte = 1 << 20;
+
+    // Too little to parse to give each thread a chunk.
+    expect_true(ParallelParser::usefulThreads(megabyte / 2, 4) == 1);
+    expect_true(ParallelParser::usefulThreads(2 * megabyte, 4) <= 2);
+    expect_true(ParallelParser::usefulThreads(0, 4) == 1);
+
+    // Never more than asked for, nor (where known) than there are cores.
+    index_type threads = ParallelParser::usefulThreads(64 * megabyte, 4);
+    expect_true(threads >= 1 && threads <= 4);
+
+#ifdef SOURCETOOLS_COMPILER_CXX11
+    index_type cores = std::thread::hardware_concurrency();
+    if (cores > 0)
+      expect_true(ParallelParser::usefulThreads(64 * megabyte, 64) <= cores);
+#endif
+
+    // Falling back to a sequential parse gives the same tree.
+    std::string code = "x <- 1\nf(a, b)\n";
+    ParseStatus expected, actual;
+    expect_true(sameTree(parseParallel(code.data(), code.size(), &actual, 4),
+                         Parser(code).parse(&expected)));
+  }
+
+  test_that("Parse errors are recorded once per token, and formatted on demand")
+  {
+    std::string code = "f(a b)\nfunction(x + 1) x\ng(h(k(";
+    ParseStatus status;
+    Parser(code).parse(&status);
+
+    // Each construct left open at the end is only reported once.
+    const std::vector<ParseError>& errors = status.getErrors();
+    expect_true(errors.size() == 3);
+    if (errors.size() != 3)
+      return;
+
+    expect_true(errors[0].code() == PARSE_ERROR_EXPECTED_ARGUMENT_SEPARATOR);
+    expect_true(errors[0].expected() == tokens::RPAREN);
+    expect_true(errors[0].start() == Position(0, 4));
+    expect_true(errors[0].end() == Position(0, 5));
+    expect_true(errors[0].message() == "expected ',' or 'bracket'");
+
+    expect_true(errors[1].code() == PARSE_ERROR_EXPECTED_FORMAL_DEFAULT);
+    expect_true(errors[1].token().contents() == "+");
+    expect_true(errors[1].message() == "expected '=', ',' or ')' following argument name");
+
+    expect_true(errors[2].code() == PARSE_ERROR_UNEXPECTED_END);
+    expect_true(errors[2].message() == "unexpected end of input");
+  }
+
+  test_that("Parse error positions can be resolved in code points")
+  {
+    std::string code = "f(\"\xc3\xa9\xc3\xa9\" b)";
+    ParseStatus status;
+    Parser(code).parse(&status);
+
+    const std::vector<ParseError>& errors = status.getErrors();
+    expect_true(errors.size() == 1);
+    if (errors.size() != 1)
+      return;
+
+    collections::LineIndex index(code.data(), code.size());
+    expect_true(errors[0].start(index) == errors[0].start());
+    expect_true(errors[0].end(index) == errors[0].end());
+    expect_true(errors[0].start(index, collections::COLUMN_CODE_POINTS) == Position(0, 7));
+    expect_true(errors[0].end(index, collections::COLUMN_CODE_POINTS) == Position(0, 8));
+  }
+
+  test_that("Parsing stops once the error limit is reached")
+  {
+    std::string code = "x <- 1\nf(a b)\nf(c d)\nf(e f)\nk <- 2\n";
+
+    ParseStatus unlimited;
+    ParseNode* pUnlimited = Parser(code).parse(&unlimited);
+    expect_true(pUnlimited->children().size() == 5);
+    expect_true(unlimited.getErrors().size() == 3);
+
+    ParseStatus limited;
+    Parser parser(code);
+    parser.setErrorLimit(2);
+    ParseNode* pLimited = parser.parse(&limited);
+    expect_true(pLimited->children().size() == 3);
+    expect_true(limited.getErrors().size() == 2);
+  }
+
+  test_that("Expressions continue on the line a multi-line token ends on")
+  {
+    std::string code = "x <- \"a\nb\" + 1\n`c\nd` - 2\ne\n- 3\n";
+
+    ParseStatus status;
+    ParseNode* pRoot = Parser(code).parse(&status);
+    expect_true(status.getErrors().empty());
+    expect_true(pRoot->children().size() == 4);
+    if (pRoot->children().size() != 4)
+      return;
+
+    expect_true(pRoot->children()[0]->token().contentsEqual(std::string("<-")));
+    expect_true(pRoot->children()[1]->token().contentsEqual(std::string("-")));
+    expect_true(pRoot->children()[1]->children().size() == 2);
+    expect_true(pRoot->children()[2]->token().contentsEqual(std::string("e")));
+    expect_true(pRoot->children()[3]->children().size() == 1);
+  }
+
+#ifdef SOURCETOOLS_COMPILER_CXX11
+  test_that("Documents can be parsed from many threads at once")
+  {
+    // A corpus touching the tokenizer (keywords, long strings and comments
+    // for the vectorized scans), the parser (including its error recovery)
+    // and the diagnostics.
+    std::vector<std::string> corpus;
+    corpus.push_back("f <- function(x, y = 2) {\n  if (x == NULL) y else x & y\n}\n");
+    corpus.push_back("for (i in seq_len(10)) while (TRUE) repeat break\n");
+    corpus.push_back("x <- \"" + repeat("long string ", 20) + "\" # " + repeat("comment ", 20) + "\n");
+    corpus.push_back("g(a b)\nfunction(x + 1) x\nh(k(\n");
+    corpus.push_back(repeat("y[[1]] <- list(a = NA_integer_, b = Inf, c = `quoted`)\n", 50));
+
+    std::vector<Analysis> expected;
+    for (std::size_t i = 0; i < corpus.size(); ++i)
+    {
+      ParseStatus status;
+      expected.push_back(analyze(corpus[i], &status));
+    }
+
+    const index_type threads = 8;
+    const index_type rounds = 20;
+    std::vector<index_type> failures(threads, 0);
+    std::vector<std::thread> workers;
+    for (index_type t = 0; t < threads; ++t)
+    {
+      workers.push_back(std::thread([&, t]() {
+        for (index_type round = 0; round < rounds; ++round)
+        {
+          for (std::size_t i = 0; i < corpus.size(); ++i)
+          {
+            ParseStatus status;
+            if (!(analyze(corpus[i], &status) == expected[i]))
+              ++failures[t];
+          }
+        }
+      }));
+    }
+
+    for (index_type t = 0; t < threads; ++t)
+    {
+      workers[t].join();
+      expect_true(failures[t] == 0);
+    }
+  }
+#endif
+
+  test_that("Deeply nested code is parsed without recursion")
+  {
+    // A million terms, folded into a (left-nested) chain of '+' nodes.
+    {
+      std::string code = "x <- 1" + repeat(" + 1", 999999);
+      Parser parser(code);
+      ParseStatus status;
+      ParseNode* pRoot = parser.parse(&status);
+      expect_true(status.getErrors().empty());
+      expect_true(utils::size(pRoot->children()) == 1);
+
+      index_type terms = 1;
+      const ParseNode* pNode = pRoot->children()[0]->children()[1];
+      for (; pNode->token().contentsEqual("+"); pNode = pNode->children()[0])
+        ++terms;
+      expect_true(terms == 1000000);
+    }
+
+    // Nesting that would overflow the C stack if parsed recursively.
+    index_type n = 100000;
+    std::string codes[] = {
+      repeat("(", n) + "1" + repeat(")", n),
+      repeat("f(x = ", n) + "1" + repeat(")", n),
+      repeat("{", n) + repeat("}", n),
+      repeat("a <- ", n) + "1",
+      repeat("-", n) + "1",
+      repeat("if (a) 1 else ", n) + "2",
+      repeat("function(x = ", n) + "1" + repeat(") x", n)
+    };
+
+    for (std::size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i)
+    {
+      Parser parser(codes[i]);
+      ParseStatus status;
+      ParseNode* pRoot = parser.parse(&status);
+      expect_true(status.getErrors().empty());
+      expect_true(utils::size(pRoot->children()) == 1);
+      expect_true(depth(pRoot) > n);
+    }
   }
 
 }
@@ -20,6 +20,45 @@ public:
   }
 };
 
+class SignificantTokenCounter : public tokenizer::TokenSink
+{
+public:
+  static const bool INCLUDE_WHITESPACE = false;
+  static const bool INCLUDE_COMMENTS   = false;
+
+  SignificantTokenCounter() : count_(0), symbols_(0) {}
+
+  void operator()(const Token& token)
+  {
+    ++count_;
+    symbols_ += token.isType(tokens::SYMBOL);
+  }
+
+  index_type count() const { return count_; }
+  index_type symbols() const { return symbols_; }
+
+private:
+  index_type count_;
+  index_type symbols_;
+};
+
+class TokenCollector : public tokenizer::TokenSink
+{
+public:
+  void operator()(const Token& token)
+  {
+    tokens_.push_back(token);
+    contents_.push_back(token.contents());
+  }
+
+  const std::vector<Token>& tokens() const { return tokens_; }
+  const std::vector<std::string>& contents() const { return contents_; }
+
+private:
+  std::vector<Token> tokens_;
+  std::vector<std::string> contents_;
+};
+
 } // anonymous namespace
 
 context("Tokenizer") {
@@ -64,6 +103,49 @@ context("Tokenizer") {
     }
   }
 
+  test_that("Every registered keyword, and nothing else, is classified as a keyword") {
+    using namespace tokens;
+
+#define CHECK_KEYWORD(__NAME__, __STRING__, __MASKS__)                  \
+    expect_true(symbolType(__STRING__) == KEYWORD_ ## __NAME__);
+
+    SOURCE_TOOLS_KEYWORDS(CHECK_KEYWORD)
+
+#undef CHECK_KEYWORD
+
+    const char* symbols[] = {
+      "", "i", "x", "iff", "fo", "For", "NA_", "NA_integer", "NA_complex_x",
+      "NA_cinteger_", "NaNa", "NULLL", "Inff", "functio", "functions", "elsewhere"
+    };
+
+    for (std::size_t i = 0; i < sizeof(symbols) / sizeof(symbols[0]); ++i)
+      expect_true(symbolType(symbols[i]) == SYMBOL);
+
+    // Every keyword round-trips (also when not followed by a nul byte).
+    for (index_type i = 0; i < tokens::detail::KEYWORD_COUNT; ++i)
+    {
+      const tokens::detail::Keyword& keyword = tokens::detail::KEYWORDS[i];
+      std::string padded = std::string(keyword.string) + "_";
+      expect_true(symbolType(keyword.string, keyword.size) == keyword.type);
+      expect_true(symbolType(padded.data(), keyword.size) == keyword.type);
+      expect_true(symbolType(padded) == SYMBOL);
+    }
+  }
+
+  test_that("The keyword table's multiplier is the first that leaves no collisions") {
+    using tokens::detail::KeywordTable;
+
+    // Search odd multipliers up from 2^32 / phi. If a new keyword makes
+    // this fail, set 'KeywordTable::MULTIPLIER' to 'multiplier'.
+    unsigned int multiplier = 2654435769u;
+    while (!KeywordTable(multiplier).perfect() && multiplier != 2654435769u + 2 * 65536)
+      multiplier += 2;
+
+    expect_true(KeywordTable(multiplier).perfect());
+    expect_true(KeywordTable().perfect());
+    expect_true(multiplier == KeywordTable::MULTIPLIER);
+  }
+
   test_that("TokenCursor operations work as expected") {
     std::string code = "if (foo) { print(bar) } else {}";
     const std::vector<Token>& tokens = sourcetools::tokenize(code);
@@ -126,4 +208,594 @@ context("Tokenizer") {
     expect_true(cursor.findBwd(locator));
     expect_true(cursor.currentToken().contentsEqual("("));
   }
+
+  test_that("Long strings, comments and raw strings are tokenized correctly")
+  {
+    std::string body;
+    for (int i = 0; i < 40; ++i)
+      body += "some \\\"text\\\"\n";
+
+    std::string code =
+      "x <- \"" + body + "\"\n" +
+      "# " + std::string(100, '-') + "\n" +
+      "r\"-(" + body + ")-\"; y";
+
+    const std::vector<Token>& tokens = sourcetools::tokenize(code);
+    expect_true(tokens.size() == 11);
+    if (tokens.size() != 11)
+      return;
+
+    expect_true(tokens[4].isType(tokens::STRING));
+    expect_true(tokens[4].size() == (index_type) body.size() + 2);
+    expect_true(tokens[6].isType(tokens::COMMENT));
+    expect_true(tokens[7].isType(tokens::STRING));
+    expect_true(tokens[10].contentsEqual("y"));
+    expect_true(tokens[10].row() == 82);
+    expect_true(tokens[10].column() == 5);
+
+    // Tokens know how many newlines they contain (a comment includes the
+    // one that ends it), and so the row they end on.
+    expect_true(tokens[4].newlines() == 40);
+    expect_true(tokens[4].endRow() == 40);
+    expect_true(tokens[5].newlines() == 1);
+    expect_true(tokens[6].newlines() == 1);
+    expect_true(tokens[7].endRow() == 82);
+    expect_true(tokens[10].endRow() == 82);
+  }
+
+  test_that("Character classes agree with the character predicates")
+  {
+    using namespace sourcetools::tokenizer;
+
+    for (int i = 0; i < 256; ++i)
+    {
+      char ch = static_cast<char>(i);
+      CharacterClass cls = characterClass(ch);
+
+      expect_true(isValidForSymbol(ch) == utils::isValidForRSymbol(ch));
+      expect_true((cls == CHARACTER_CLASS_WHITESPACE) == utils::isWhitespace(ch));
+      expect_true((cls == CHARACTER_CLASS_DIGIT) == utils::isDigit(ch));
+
+      bool isSymbolStart =
+        cls == CHARACTER_CLASS_SYMBOL ||
+        cls == CHARACTER_CLASS_RAW ||
+        cls == CHARACTER_CLASS_DOT;
+      expect_true(isSymbolStart == utils::isValidForStartOfRSymbol(ch));
+
+      bool isSingle = singleCharacterTokenType(ch) != tokens::INVALID;
+      expect_true(isSingle == (cls == CHARACTER_CLASS_SINGLE));
+    }
+
+    expect_true(singleCharacterTokenType('{') == tokens::LBRACE);
+    expect_true(singleCharacterTokenType('^') == tokens::OPERATOR_HAT);
+    expect_true(singleCharacterTokenType(';') == tokens::SEMI);
+  }
+
+  test_that("Every registered single-character token is dispatched on directly")
+  {
+    using namespace sourcetools::tokenizer;
+
+    struct Entry { const char* string; tokens::TokenType type; };
+
+#define OPERATOR_ENTRY(__NAME__, __STRING__, __MASKS__) \
+    { __STRING__, tokens::OPERATOR_ ## __NAME__ },
+    const Entry operators[] = { SOURCE_TOOLS_OPERATORS(OPERATOR_ENTRY) };
+#undef OPERATOR_ENTRY
+    index_type count = sizeof(operators) / sizeof(operators[0]);
+
+    // A one-character operator is determined by its character exactly
+    // when no other operator starts with that character.
+    for (index_type i = 0; i < count; ++i)
+    {
+      char ch = operators[i].string[0];
+      bool single = std::strlen(operators[i].string) == 1;
+      for (index_type j = 0; j < count; ++j)
+        if (j != i && operators[j].string[0] == ch)
+          single = false;
+
+      tokens::TokenType expected = single ? operators[i].type : tokens::INVALID;
+      expect_true(singleCharacterTokenType(ch) == expected);
+    }
+
+    // Each character in the table produces its token on its own, and is
+    // the registered string of any operator it maps to.
+    index_type singles = 0;
+    for (int i = 0; i < 256; ++i)
+    {
+      char ch = static_cast<char>(i);
+      tokens::TokenType type = singleCharacterTokenType(ch);
+      if (type == tokens::INVALID)
+        continue;
+
+      ++singles;
+      std::string code = std::string(1, ch) + std::string(1, ch);
+      const std::vector<Token>& tokens = sourcetools::tokenize(code);
+      expect_true(tokens.size() == 2);
+      expect_true(tokens[0].isType(type) && tokens[0].size() == 1);
+
+      for (index_type j = 0; j < count; ++j)
+        if (operators[j].type == type)
+          expect_true(std::string(operators[j].string) == std::string(1, ch));
+    }
+
+#define SINGLE_CHARACTER_COUNT(__CH__, __TYPE__) + 1
+    expect_true(singles == 0 SOURCE_TOOLS_SINGLE_CHARACTER_TOKENS(SINGLE_CHARACTER_COUNT));
+#undef SINGLE_CHARACTER_COUNT
+  }
+
+  test_that("Positions can be resolved through a line index")
+  {
+    std::string code =
+      "x <- 1\n"
+      "\n"
+      "f <- function(a = \"multi\nline\") {\n"
+      "  a + x  # comment\n"
+      "}";
+
+    const std::vector<Token>& tracked = sourcetools::tokenize(code);
+    const std::vector<Token>& untracked =
+      sourcetools::tokenize(code.data(), code.size(), false);
+
+    expect_true(tracked.size() == untracked.size());
+    if (tracked.size() != untracked.size())
+      return;
+
+    collections::LineIndex index(code.data(), code.size());
+    expect_true(index.rows() == 6);
+
+    for (std::size_t i = 0; i < tracked.size(); ++i)
+    {
+      expect_true(tracked[i].hasPosition());
+      expect_false(untracked[i].hasPosition());
+      expect_true(untracked[i].offset() == tracked[i].offset());
+      expect_true(untracked[i].position(index) == tracked[i].position());
+      expect_true(tracked[i].position(index) == tracked[i].position());
+      expect_true(index.offset(tracked[i].position()) == tracked[i].offset());
+    }
+  }
+
+  test_that("Line indices report columns in code points and UTF-16 units")
+  {
+    using namespace collections;
+
+    // 'é' is two bytes in UTF-8, '€' three, and '😀' four (and a surrogate
+    // pair in UTF-16). The long ASCII prefix exercises the vectorized scan.
+    std::string prefix(100, 'a');
+    std::string code =
+      "x <- 1\n" +
+      prefix + " <- \"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\" + b\n"
+      "y";
+
+    LineIndex index(code.data(), code.size());
+    expect_true(index.valid());
+
+    index_type b = code.find(" + b") + 3;
+    expect_true(index.position(b, COLUMN_BYTES) == Position(1, 118));
+    expect_true(index.position(b, COLUMN_CODE_POINTS) == Position(1, 112));
+    expect_true(index.position(b, COLUMN_UTF16) == Position(1, 113));
+
+    expect_true(index.offset(Position(1, 112), COLUMN_CODE_POINTS) == b);
+    expect_true(index.offset(Position(1, 113), COLUMN_UTF16) == b);
+
+    // ASCII lines are unaffected.
+    index_type y = code.size() - 1;
+    expect_true(index.position(y, COLUMN_UTF16) == Position(2, 0));
+    expect_true(index.position(3, COLUMN_CODE_POINTS) == Position(0, 3));
+
+    // A cursor gives the same positions for a run of token offsets.
+    std::vector<tokens::Token> tokens = sourcetools::tokenize(code);
+    LineIndex::Cursor points(index, COLUMN_CODE_POINTS);
+    LineIndex::Cursor units(index, COLUMN_UTF16);
+    for (std::size_t i = 0; i < tokens.size(); ++i)
+    {
+      index_type offset = tokens[i].offset();
+      expect_true(points.position(offset) == index.position(offset, COLUMN_CODE_POINTS));
+      expect_true(units.position(offset) == index.position(offset, COLUMN_UTF16));
+    }
+    expect_true(points.position(b) == Position(1, 112));
+
+    // Overlong encodings, surrogates and truncated sequences are malformed.
+    const char* malformed[] = { "ab\xC0\xAF", "ab\xED\xA0\x80", "ab\xE2\x82", "ab\xFF" };
+    for (std::size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); ++i)
+    {
+      LineIndex bad(malformed[i], std::strlen(malformed[i]));
+      expect_false(bad.valid());
+      expect_true(bad.malformed() == 2);
+    }
+
+    expect_true(simd::findNonAscii(code.data(), code.data() + code.size()) ==
+                code.data() + code.find('\xC3'));
+  }
+
+  test_that("Token buffers store the same tokens as token vectors")
+  {
+    std::string code =
+      "if (x[[1]] >= 2L) {\n"
+      "  y <- `my var` %in% c(\"a\\nb\", 'c')  # comment\n"
+      "} else function(...) NULL |> f()\n";
+
+    const std::vector<Token>& expected = sourcetools::tokenize(code);
+
+    tokens::TokenBuffer buffer;
+    sourcetools::tokenize(code.data(), code.size(), &buffer);
+
+    expect_true(buffer.size() == (index_type) expected.size());
+    if (buffer.size() != (index_type) expected.size())
+      return;
+
+    for (index_type i = 0; i < buffer.size(); ++i)
+    {
+      const Token& lhs = expected[i];
+      Token rhs = buffer[i];
+
+      expect_true(tokens::expand(tokens::compact(lhs.type())) == lhs.type());
+      expect_true(buffer.type(i) == lhs.type());
+      expect_true(buffer.offset(i) == lhs.offset());
+      expect_true(buffer.size(i) == lhs.size());
+      expect_true(rhs.begin() == lhs.begin());
+      expect_true(rhs.end() == lhs.end());
+      expect_true(rhs.position() == lhs.position());
+      expect_true(rhs.newlines() == lhs.newlines());
+    }
+
+    TokenBufferCursor cursor(buffer);
+    expect_true(cursor.moveToPosition(1, 4));
+    expect_true(cursor.currentToken().contentsEqual(std::string("<-")));
+    expect_true(cursor.fwdToMatchingBracket() == false);
+    expect_true(cursor.findFwd("("));
+    expect_true(cursor.fwdToMatchingBracket());
+    expect_true(cursor.nextSignificantToken().contentsEqual(std::string("}")));
+  }
+
+  test_that("Tokens can be passed to a sink as they're produced")
+  {
+    std::string code = "x <- y + z  # comment\n(a)";
+
+    SignificantTokenCounter counter;
+    sourcetools::tokenize(code.data(), code.size(), counter);
+    expect_true(counter.count() == 8);
+    expect_true(counter.symbols() == 4);
+
+    tokens::TokenBuffer buffer;
+    sourcetools::tokenize(code.data(), code.size(), &buffer);
+    expect_true(buffer.size() == (index_type) sourcetools::tokenize(code).size());
+  }
+
+  test_that("SyntaxValidator can validate tokens as they're produced")
+  {
+    using namespace sourcetools::validators;
+
+    std::string code = "(1)\nx y\n(a}";
+
+    collections::LineIndex index(code.data(), code.size());
+    SyntaxValidator validator(index);
+    sourcetools::tokenize(code.data(), code.size(), validator);
+
+    const std::vector<SyntaxError>& errors = validator.errors();
+    expect_true(errors.size() == 2);
+    if (errors.size() != 2)
+      return;
+
+    expect_true(errors[0].position() == collections::Position(1, 2));
+    expect_true(errors[1].position() == collections::Position(2, 2));
+
+    SyntaxValidator other(sourcetools::tokenize(code));
+    expect_true(other.errors().size() == 2);
+
+    // Without positions, tokens are compared by the rows they start on,
+    // as with them.
+    std::string multiline = "\"a\nb\" c\n'd' e\n`f\ng`\nh 1";
+    collections::LineIndex multilineIndex(multiline.data(), multiline.size());
+    SyntaxValidator offsets(multilineIndex);
+    sourcetools::tokenize(multiline.data(), multiline.size(), offsets);
+    SyntaxValidator positions(sourcetools::tokenize(multiline));
+
+    expect_true(offsets.errors().size() == 2);
+    expect_true(offsets.errors().size() == positions.errors().size());
+    for (std::size_t i = 0; i < offsets.errors().size() && i < positions.errors().size(); ++i)
+      expect_true(offsets.errors()[i].position() == positions.errors()[i].position());
+
+    // Columns can be counted in characters; '\xe9\xac\xbc' is one code point.
+    std::string wide = "\xe9\xac\xbc\xe9\x96\x80 x";
+    collections::LineIndex wideIndex(wide.data(), wide.size());
+    SyntaxValidator chars(wideIndex, collections::COLUMN_CODE_POINTS);
+    sourcetools::tokenize(wide.data(), wide.size(), chars);
+    expect_true(chars.errors().size() == 1);
+    if (!chars.errors().empty())
+      expect_true(chars.errors()[0].position() == collections::Position(0, 3));
+  }
+
+  test_that("The significant-token policy skips whitespace and comments")
+  {
+    std::string code =
+      "#' @param x\n#' @export\nf <- function(x) { # trailing\n"
+      "  x[[1]]  \t+ 2 # done\n}\n\n# no newline at the end";
+
+    std::vector<Token> expected;
+    const std::vector<Token>& tokens = sourcetools::tokenize(code);
+    for (std::size_t i = 0; i < tokens.size(); ++i)
+      if (!isWhitespace(tokens[i]) && !isComment(tokens[i]))
+        expected.push_back(tokens[i]);
+
+    std::vector<Token> actual;
+    Token token;
+    tokenizer::SignificantTokenizer tokenizer(code.data(), code.size());
+    while (tokenizer.tokenize(&token))
+      actual.push_back(token);
+
+    expect_true(actual.size() == expected.size());
+    if (actual.size() != expected.size())
+      return;
+
+    for (std::size_t i = 0; i < expected.size(); ++i)
+    {
+      expect_true(actual[i].begin() == expected[i].begin());
+      expect_true(actual[i].end() == expected[i].end());
+      expect_true(actual[i].type() == expected[i].type());
+      expect_true(actual[i].position() == expected[i].position());
+    }
+  }
+
+  test_that("Buffered lookahead agrees with the token stream")
+  {
+    std::string code = "list(a = 1, b = c(2, 3), `c d` = 'e')[[1]]";
+    const std::vector<Token>& tokens = sourcetools::tokenize(code);
+    index_type n = tokens.size();
+
+    for (index_type lookahead = 0; lookahead <= 12; ++lookahead)
+    {
+      tokenizer::BufferedTokenizer<tokenizer::Tokenizer> tokenizer(code.data(), code.size());
+      Token token;
+      for (index_type i = 0; tokenizer.tokenize(&token); ++i)
+      {
+        expect_true(token.begin() == tokens[i].begin());
+
+        const Token& peeked = tokenizer.peek(lookahead);
+        if (lookahead == 0 || i + lookahead >= n)
+          expect_true(peeked.isType(tokens::END));
+        else
+          expect_true(peeked.begin() == tokens[i + lookahead].begin());
+      }
+    }
+  }
+
+  test_that("Parallel tokenization produces the same tokens as sequential tokenization")
+  {
+    std::string code =
+      "x[[1\n]] + y[\n2]\n"
+      "z <- \"a\nb\nc\"; w <- r\"-(\n)\n)-\"\n"
+      "# comment\n"
+      "v[[a[\n1]\n]]\n]\n"
+      "f <- function(a, b) {\n  a %in% b\n}\n";
+
+    const std::vector<Token>& expected = sourcetools::tokenize(code);
+
+    for (index_type chunkSize = 1; chunkSize < 64; chunkSize += 3)
+    {
+      for (index_type threads = 1; threads <= 3; ++threads)
+      {
+        const std::vector<Token>& actual = sourcetools::tokenizeParallel(
+          code.data(), code.size(), threads, chunkSize);
+
+        expect_true(actual.size() == expected.size());
+        if (actual.size() != expected.size())
+          continue;
+
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+          expect_true(actual[i].begin() == expected[i].begin());
+          expect_true(actual[i].end() == expected[i].end());
+          expect_true(actual[i].type() == expected[i].type());
+          expect_true(actual[i].position() == expected[i].position());
+          expect_true(actual[i].newlines() == expected[i].newlines());
+        }
+      }
+    }
+  }
+
+  test_that("Re-tokenizing after an edit matches tokenizing from scratch")
+  {
+    std::string original =
+      "x[[1\n]] + y[\n2]\n"
+      "z <- \"a\nb\nc\"; w <- r\"-(\n)\n)-\"\n"
+      "# comment\n"
+      "v[[a[\n1]\n]]\n]\n"
+      "f <- function(a, b) {\n  a %in% b\n}\n";
+
+    const char* replacements[] = {
+      "", "-", "<", "\"", "'", "#", "\n", "[", "]", "[[", "]]",
+      "1e", "r\"(", "abc def", "`", " ", "%"
+    };
+
+    index_type n = original.size();
+    for (index_type begin = 0; begin <= n; ++begin)
+    {
+      for (index_type end = begin; end <= n && end <= begin + 3; ++end)
+      {
+        for (std::size_t i = 0; i < sizeof(replacements) / sizeof(replacements[0]); ++i)
+        {
+          std::string code = original;
+          std::vector<Token> actual = sourcetools::tokenize(code);
+          sourcetools::retokenize(&code, &actual, begin, end, replacements[i]);
+
+          const std::vector<Token>& expected = sourcetools::tokenize(code);
+          expect_true(actual.size() == expected.size());
+          if (actual.size() != expected.size())
+            continue;
+
+          for (std::size_t j = 0; j < expected.size(); ++j)
+          {
+            expect_true(actual[j].begin() == expected[j].begin());
+            expect_true(actual[j].end() == expected[j].end());
+            expect_true(actual[j].offset() == expected[j].offset());
+            expect_true(actual[j].type() == expected[j].type());
+            expect_true(actual[j].position() == expected[j].position());
+            expect_true(actual[j].newlines() == expected[j].newlines());
+          }
+        }
+      }
+    }
+  }
+
+  test_that("Streaming tokenization produces the same tokens as tokenizing all at once")
+  {
+    std::string code =
+      "x[[1\n]] + y[\n2]\n"
+      "z <<- \"a\nb\nc\"; w <- r\"-(\n)\n)-\"\n"
+      "# comment\n"
+      "v[[a[\n1]\n]]\n]\n"
+      "f <- function(a, b) {\n  a %in% b\n}\n"
+      "s <- \"a\\\\\\\"b\" + 'c\\'d' %o% `e\\`f` # end\n"
+      "1.5e-3L <= 2";
+
+    const std::vector<Token>& expected = sourcetools::tokenize(code);
+
+    for (index_type chunkSize = 1; chunkSize <= 16; ++chunkSize)
+    {
+      TokenCollector collector;
+      tokenizer::StreamingTokenizer tokenizer;
+      for (index_type i = 0; i < utils::size(code); i += chunkSize)
+      {
+        index_type n = std::min(chunkSize, utils::size(code) - i);
+
+        // Resume from a saved state halfway through.
+        if (i == utils::size(code) / 2)
+          tokenizer = tokenizer::StreamingTokenizer(tokenizer.state());
+
+        tokenizer.feed(code.data() + i, n, collector);
+      }
+      tokenizer.finish(collector);
+
+      const std::vector<Token>& actual = collector.tokens();
+      expect_true(actual.size() == expected.size());
+      if (actual.size() != expected.size())
+        continue;
+
+      for (std::size_t i = 0; i < expected.size(); ++i)
+      {
+        expect_true(collector.contents()[i] == expected[i].contents());
+        expect_true(actual[i].offset() == expected[i].offset());
+        expect_true(actual[i].type() == expected[i].type());
+        expect_true(actual[i].position() == expected[i].position());
+        expect_true(actual[i].newlines() == expected[i].newlines());
+      }
+    }
+  }
+
+  test_that("Symbols are interned into dense ids")
+  {
+    using collections::NO_SYMBOL;
+
+    std::string code = "foo <- bar(foo, `foo`, `a\\`b`, 'foo', if)";
+    collections::SymbolTable symbols;
+    tokenizer::SignificantTokenizer tokenizer(code.data(), code.size());
+    tokenizer.setSymbolTable(&symbols);
+
+    std::vector<Token> tokens;
+    Token token;
+    while (tokenizer.tokenize(&token))
+      tokens.push_back(token);
+
+    expect_true(tokens.size() == 14);
+    if (tokens.size() != 14)
+      return;
+
+    // foo, bar, foo, `foo`, `a\`b`
+    expect_true(tokens[0].symbol() == 0);
+    expect_true(tokens[2].symbol() == 1);
+    expect_true(tokens[4].symbol() == 0);
+    expect_true(tokens[6].symbol() == 0);
+    expect_true(tokens[8].symbol() == 2);
+
+    // Strings, keywords and operators aren't interned.
+    expect_true(tokens[1].symbol() == NO_SYMBOL);
+    expect_true(tokens[10].symbol() == NO_SYMBOL);
+    expect_true(tokens[12].symbol() == NO_SYMBOL);
+
+    expect_true(symbols.size() == 3);
+    expect_true(symbols.name(0) == "foo");
+    expect_true(symbols.name(2) == "a`b");
+    expect_true(symbols.find("bar") == 1);
+    expect_true(symbols.find("baz") == NO_SYMBOL);
+
+    // Interning many names forces the table to grow.
+    for (index_type i = 0; i < 1000; ++i)
+    {
+      std::stringstream ss;
+      ss << "x" << i;
+      expect_true(symbols.intern(ss.str()) == static_cast<collections::SymbolId>(i + 3));
+    }
+    expect_true(symbols.intern("bar") == 1);
+  }
+
+  test_that("String values refer to the source unless they need decoding")
+  {
+    std::string code = "'plain' \"a\\tb\\101\\x42\" `sym` `a\\`b` ''";
+    const std::vector<Token>& tokens = sourcetools::tokenize(code);
+
+    std::string buffer;
+    StringView value = tokens::stringValue(tokens[0], &buffer);
+    expect_true(value.str() == "plain");
+    expect_true(value.begin() == tokens[0].begin() + 1);
+    expect_true(buffer.empty());
+
+    value = tokens::stringValue(tokens[2], &buffer);
+    expect_true(value.str() == "a\tbAB");
+    expect_true(value.begin() == buffer.data());
+
+    value = tokens::stringValue(tokens[4], &buffer);
+    expect_true(value.str() == "sym");
+    expect_true(value.begin() == tokens[4].begin() + 1);
+
+    expect_true(tokens::stringValue(tokens[6], &buffer).str() == "a`b");
+    expect_true(tokens::stringValue(tokens[8], &buffer).empty());
+    expect_true(tokens::stringValue(tokens[2]) == "a\tbAB");
+  }
+
+  test_that("Numeric literals are decoded exactly")
+  {
+    using namespace tokens;
+
+    const char* doubles[] = {
+      "0", "1", "0.1", ".5", "100.", "1e5", "1E-5", "1.5e+3", "123456789.125",
+      "0.30000000000000004", "1e22", "1e23", "1e-300", "4.9e-324", "1e400",
+      "12345678901234567890123", "3.141592653589793238462643383279"
+    };
+
+    for (std::size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); ++i)
+    {
+      const char* literal = doubles[i];
+      NumericValue value = numericValue(literal, literal + std::strlen(literal));
+      expect_true(value.type == NUMERIC_DOUBLE);
+      expect_true(value.value == std::strtod(literal, NULL));
+    }
+
+    std::string code = "0x1F 0xffL 10L 1e3L 1.5L 3000000000L 2i 0x10i";
+    tokens::TokenBuffer buffer;
+    sourcetools::tokenize(code.data(), code.size(), &buffer);
+
+    NumericType types[] = {
+      NUMERIC_DOUBLE, NUMERIC_INTEGER, NUMERIC_INTEGER, NUMERIC_INTEGER,
+      NUMERIC_DOUBLE, NUMERIC_DOUBLE, NUMERIC_COMPLEX, NUMERIC_COMPLEX
+    };
+    double values[] = { 31, 255, 10, 1000, 1.5, 3E9, 2, 16 };
+
+    for (index_type i = 0; i < 8; ++i)
+    {
+      expect_true(buffer.type(2 * i) == NUMBER);
+      expect_true(buffer.numericValue(2 * i).type == types[i]);
+      expect_true(buffer.numericValue(2 * i).value == values[i]);
+    }
+
+    // A '0x' prefix without any digits is an invalid token of its own.
+    std::string hex = "0xG";
+    const std::vector<Token>& invalid = sourcetools::tokenize(hex);
+    expect_true(invalid.size() == 2);
+    if (invalid.size() == 2)
+    {
+      expect_true(invalid[0].isType(INVALID));
+      expect_true(invalid[0].contentsEqual(std::string("0x")));
+      expect_true(invalid[1].isType(SYMBOL));
+    }
+  }
 }